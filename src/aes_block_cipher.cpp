@@ -2,10 +2,20 @@
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <algorithm>
+#include <vector>
 
 #include "aes_block_cipher.h"
 #include "common_utils.h"
+#include "instrument.h"
 
+// Tag compare without an early exit, the time taken doesn't depend on where the tags differ
+static bool tag_equal (const uint8_t *a, const uint8_t *b, int num_bytes) {
+	uint8_t diff = 0;
+	for(int j=0;j<num_bytes;j++)
+		diff |= a[j] ^ b[j];
+	return diff == 0;
+}
 
 /****************************************************************
 	Basic AES Block Cipher
@@ -54,7 +64,7 @@ aes_block_cipher::aes_block_cipher (int key_sz) {
 // 		B1 B5 B9  B13 ...
 // 		B2 B6 B10 B14 ...
 // 		B3 B7 B11 B15 ...
-void aes_block_cipher::init_keys (uint8_t *key_bytes) {
+void aes_block_cipher::init_keys (const uint8_t *key_bytes) {
 	for(int i=0;i<num_key_words;i++) {
 		key[i] = 0;
 		for(int j=0;j<4;j++) {
@@ -73,6 +83,7 @@ void aes_block_cipher::init_keys (uint8_t *key_bytes) {
 // 		B2 B6 B10 B14
 // 		B3 B7 B11 B15
 void aes_block_cipher::encrypt_block (const uint8_t *pt, uint8_t *ct) {
+	INSTR_TIMED(INSTR_ENCRYPT_BLOCK, 1);
 	uint32_t buf[4];
 	
 	for(int i=0;i<4;i++) {
@@ -101,6 +112,7 @@ void aes_block_cipher::encrypt_block (const uint8_t *pt, uint8_t *ct) {
 }
 
 void aes_block_cipher::decrypt_block (uint8_t *pt, const uint8_t *ct) {
+	INSTR_TIMED(INSTR_DECRYPT_BLOCK, 1);
 
 	uint32_t buf[4];
 
@@ -128,6 +140,18 @@ void aes_block_cipher::decrypt_block (uint8_t *pt, const uint8_t *ct) {
 			
 }
 
+// Multi block versions, blocks are independent of each other
+// The reference backend has no pipelining and does them one by one
+void aes_block_cipher::encrypt_blocks (const uint8_t *pt, uint8_t *ct, int num_blocks) {
+	for(int i=0;i<num_blocks;i++)
+		encrypt_block(pt+i*16,ct+i*16);
+}
+
+void aes_block_cipher::decrypt_blocks (uint8_t *pt, const uint8_t *ct, int num_blocks) {
+	for(int i=0;i<num_blocks;i++)
+		decrypt_block(pt+i*16,ct+i*16);
+}
+
 // Private Helper functions
 
 // Generates forward and reverse sbox tables by calculating multiplicative inverse in GF(2^8)
@@ -141,6 +165,7 @@ void aes_block_cipher::generate_sbox() {
 
 // Performs AES key expansion
 int aes_block_cipher::generate_key_schedule() {
+	INSTR_TIMED(INSTR_KEY_SCHEDULE, 1);
 	
 	const uint32_t rcon[] = {0x0,0x01000000,0x02000000,0x04000000,0x08000000,0x10000000,0x20000000,0x40000000,0x80000000,0x1b000000,0x36000000}; 
 	
@@ -322,18 +347,18 @@ uint32_t aes_block_cipher::mix_cols (uint32_t col, bool is_fwd) {
 	AES for bigger blocks - Electronic Code Book (ECB) Mode
 ****************************************************************/
 
-aes_ecb::aes_ecb(int key_size) : aes_block_cipher(key_size) {
+template <class block_cipher>
+ecb_mode<block_cipher>::ecb_mode(int key_size) : block_cipher (key_size) {
 }
 
-void aes_ecb::encrypt (const uint8_t *pt, uint8_t *ct, int num_blocks) {
-	for(int i=0;i<num_blocks;i++)
-		encrypt_block(pt+(i*16), ct+(i*16));
+template <class block_cipher>
+void ecb_mode<block_cipher>::encrypt (const uint8_t *pt, uint8_t *ct, int num_blocks) {
+	this->encrypt_blocks(pt, ct, num_blocks);
 }
 
-void aes_ecb::decrypt (uint8_t *pt, const uint8_t *ct, int num_blocks) {
-	
-	for(int i=0;i<num_blocks;i++)
-		decrypt_block(pt+(i*16), ct+(i*16));
+template <class block_cipher>
+void ecb_mode<block_cipher>::decrypt (uint8_t *pt, const uint8_t *ct, int num_blocks) {
+	this->decrypt_blocks(pt, ct, num_blocks);
 }
 
 
@@ -341,34 +366,37 @@ void aes_ecb::decrypt (uint8_t *pt, const uint8_t *ct, int num_blocks) {
 	AES for bigger blocks - Cipher Block Chain (CBC) Mode
 ****************************************************************/
 
-aes_cbc::aes_cbc(int key_size) : aes_block_cipher(key_size) {
+template <class block_cipher>
+cbc_mode<block_cipher>::cbc_mode(int key_size) : block_cipher (key_size) {
 }
 
-void aes_cbc::encrypt(const uint8_t *pt, uint8_t *ct, const uint8_t *iv, int num_blocks) {
+template <class block_cipher>
+void cbc_mode<block_cipher>::encrypt(const uint8_t *pt, uint8_t *ct, const uint8_t *iv, int num_blocks) {
 	
 	for(int i=0;i<16;i++)
 		ct[i] = pt[i] ^ iv[i];
 	
-	encrypt_block(ct,ct);
+	this->encrypt_block(ct,ct);
 	
 	for(int i=1;i<num_blocks;i++) {
 		for (int j=0;j<16;j++) {
 			ct[i*16+j] = pt[i*16+j] ^ ct[(i-1)*16+j];
 		}
-		encrypt_block(ct+(i*16),ct+(i*16));
+		this->encrypt_block(ct+(i*16),ct+(i*16));
 		
 	}
 		
 }
 
-void aes_cbc::decrypt (uint8_t *pt, const uint8_t *ct, const uint8_t *iv, int num_blocks) {
-	decrypt_block(pt,ct);
+template <class block_cipher>
+void cbc_mode<block_cipher>::decrypt (uint8_t *pt, const uint8_t *ct, const uint8_t *iv, int num_blocks) {
+	// Unlike encryption, block decryptions are independent of each other
+	this->decrypt_blocks(pt,ct,num_blocks);
 	
-	for(int i=0;i<16;i++)
+	for(int i=0;i<16 && num_blocks>0;i++)
 		pt[i] ^= iv[i];
 	
 	for (int i=1;i<num_blocks;i++) {
-		decrypt_block(pt+i*16,ct+i*16);	
 		for(int j=0;j<16;j++)
 			pt[i*16+j] ^= ct[(i-1)*16+j];
 	}
@@ -378,72 +406,76 @@ void aes_cbc::decrypt (uint8_t *pt, const uint8_t *ct, const uint8_t *iv, int nu
 	AES for bigger blocks - Cipher Feed Back (CFB) Mode
 ****************************************************************/
 
-aes_cfb::aes_cfb(int key_size) : aes_block_cipher(key_size) {
+template <class block_cipher>
+cfb_mode<block_cipher>::cfb_mode(int key_size) : block_cipher (key_size) {
 }
 
-void aes_cfb::encrypt(const uint8_t *pt, uint8_t *ct, const uint8_t *iv, int num_blocks) {
+template <class block_cipher>
+void cfb_mode<block_cipher>::encrypt(const uint8_t *pt, uint8_t *ct, const uint8_t *iv, int num_blocks) {
 	
-	encrypt_block(iv,ct);
+	this->encrypt_block(iv,ct);
 	
 	for(int i=0;i<16;i++)
 		ct[i] ^= pt[i];
 	
 	for(int i=1;i<num_blocks;i++) {
-		encrypt_block(ct+(i-1)*16,ct+i*16);
+		this->encrypt_block(ct+(i-1)*16,ct+i*16);
 		
 		for (int j=0;j<16;j++) 
 			ct[i*16+j] ^= pt[i*16+j];
 	}	
 }
 
-void aes_cfb::decrypt (uint8_t *pt, const uint8_t *ct, const uint8_t *iv, int num_blocks) {
+template <class block_cipher>
+void cfb_mode<block_cipher>::decrypt (uint8_t *pt, const uint8_t *ct, const uint8_t *iv, int num_blocks) {
 	
-	encrypt_block(iv,pt);
+	if (num_blocks == 0)
+		return;
 	
-	for(int i=0;i<16;i++)
-		pt[i] ^= ct[i];
+	// Cipher inputs are all known upfront - iv, C1 .. Cn-1
+	this->encrypt_block(iv,pt);
+	this->encrypt_blocks(ct,pt+16,num_blocks-1);
 	
-	for(int i=1;i<num_blocks;i++) {
-		encrypt_block(ct+(i-1)*16,pt+i*16);
-		
-		for (int j=0;j<16;j++) 
-			pt[i*16+j] ^= ct[i*16+j];
-	}	
+	for(int i=0;i<num_blocks*16;i++)
+		pt[i] ^= ct[i];
 }
 
 /****************************************************************
 	AES for bigger blocks - Output Feed Back (OFB) Mode
 ****************************************************************/
 
-aes_ofb::aes_ofb(int key_size) : aes_block_cipher(key_size) {
+template <class block_cipher>
+ofb_mode<block_cipher>::ofb_mode(int key_size) : block_cipher (key_size) {
 }
 
-void aes_ofb::encrypt(const uint8_t *pt, uint8_t *ct, const uint8_t *iv, int num_blocks) {
+template <class block_cipher>
+void ofb_mode<block_cipher>::encrypt(const uint8_t *pt, uint8_t *ct, const uint8_t *iv, int num_blocks) {
 	
 	uint8_t output[16];
-	encrypt_block(iv,output);
+	this->encrypt_block(iv,output);
 	
 	for(int i=0;i<16;i++)
 		ct[i] = output[i] ^ pt[i];
 	
 	for(int i=1;i<num_blocks;i++) {
-		encrypt_block(output,output);
+		this->encrypt_block(output,output);
 		
 		for (int j=0;j<16;j++) 
 			ct[i*16+j] = pt[i*16+j] ^ output[j];
 	}	
 }
 
-void aes_ofb::decrypt (uint8_t *pt, const uint8_t *ct, const uint8_t *iv, int num_blocks) {
+template <class block_cipher>
+void ofb_mode<block_cipher>::decrypt (uint8_t *pt, const uint8_t *ct, const uint8_t *iv, int num_blocks) {
 	
 	uint8_t output[16];
-	encrypt_block(iv,output);
+	this->encrypt_block(iv,output);
 	
 	for(int i=0;i<16;i++)
 		pt[i] = output[i] ^ ct[i];
 	
 	for(int i=1;i<num_blocks;i++) {
-		encrypt_block(output,output);
+		this->encrypt_block(output,output);
 		
 		for (int j=0;j<16;j++) 
 			pt[i*16+j] = ct[i*16+j] ^ output[j];
@@ -453,66 +485,58 @@ void aes_ofb::decrypt (uint8_t *pt, const uint8_t *ct, const uint8_t *iv, int nu
 /****************************************************************
 	AES for bigger blocks - Counter (CTR) Mode
 ****************************************************************/
-aes_ctr::aes_ctr(int key_size) : aes_block_cipher(key_size) {
+template <class block_cipher>
+ctr_mode<block_cipher>::ctr_mode(int key_size) : block_cipher (key_size) {
 }
 
-void aes_ctr::encrypt(const uint8_t *pt, uint8_t *ct, const uint8_t *iv, int num_blocks) {
+template <class block_cipher>
+void ctr_mode<block_cipher>::encrypt(const uint8_t *pt, uint8_t *ct, const uint8_t *iv, int num_blocks) {
 	
-	uint8_t cntr[16], cntr_enc[16];
+	uint8_t cntr[16], cntr_blks[AES_MAX_BLOCKS][16];
 	
 	for(int i=0;i<16;i++)
 		cntr[i] = iv[i];
 	
-	for(int i=0;i<num_blocks;i++) {
-		encrypt_block(cntr,cntr_enc);
-		
-		for (int j=0;j<16;j++) 
-			ct[i*16+j] = pt[i*16+j] ^ cntr_enc[j];
+	for(int base=0;base<num_blocks;base+=AES_MAX_BLOCKS) {
+		int n = std::min(AES_MAX_BLOCKS, num_blocks-base);
+		INSTR_COUNT(INSTR_INCR_CNTR, n);
 		
-		uint16_t temp;
-		for(int k=15;k>=0;k--) {
-			temp = cntr[k] + 1;
-			cntr[k] = uint8_t (temp);
-			if(temp >> 8 == 0)
-				break;
+		for(int b=0;b<n;b++) {
+			std::memcpy(cntr_blks[b],cntr,16);
+			
+			// increment cntr
+			uint16_t temp;
+			for(int k=15;k>=0;k--) {
+				temp = cntr[k] + 1;
+				cntr[k] = uint8_t (temp);
+				if(temp >> 8 == 0)
+					break;
+			}
 		}
-	}	
-}
-
-void aes_ctr::decrypt (uint8_t *pt, const uint8_t *ct, const uint8_t *iv, int num_blocks) {
-	
-	uint8_t cntr[16], cntr_enc[16];
-	
-	for(int i=0;i<16;i++)
-		cntr[i] = iv[i];
-	
-	for(int i=0;i<num_blocks;i++) {
-		encrypt_block(cntr,cntr_enc);
 		
-		for (int j=0;j<16;j++) 
-			pt[i*16+j] = ct[i*16+j] ^ cntr_enc[j];
-		
-		// increment cntr
-		uint16_t temp;
-		for(int k=15;k>=0;k--) {
-			temp = cntr[k] + 1;
-			cntr[k] = uint8_t (temp);
-			if(temp >> 8 == 0)
-				break;
-		}
+		this->encrypt_blocks(cntr_blks[0],cntr_blks[0],n);
 		
+		for (int j=0;j<n*16;j++) 
+			ct[base*16+j] = pt[base*16+j] ^ cntr_blks[j/16][j%16];
 	}	
-	
+}
+
+template <class block_cipher>
+void ctr_mode<block_cipher>::decrypt (uint8_t *pt, const uint8_t *ct, const uint8_t *iv, int num_blocks) {
+	encrypt(ct,pt,iv,num_blocks);
 }
 
 /****************************************************************
 	AES for bigger blocks - Galois Counter Mode (GCM)
 ****************************************************************/
 
-aes_gcm::aes_gcm(int key_sz) :  aes_block_cipher ( key_sz) {
+template <class block_cipher>
+gcm_mode<block_cipher>::gcm_mode(int key_sz) : block_cipher (key_sz) {
 }
 
-void aes_gcm::incr_cntr(uint8_t *cntr) {
+template <class block_cipher>
+void gcm_mode<block_cipher>::incr_cntr(uint8_t *cntr) {
+	INSTR_COUNT(INSTR_INCR_CNTR, 1);
 	uint16_t temp;
 	for(int k=15;k>=0;k--) {
 		temp = cntr[k] + 1;
@@ -522,7 +546,35 @@ void aes_gcm::incr_cntr(uint8_t *cntr) {
 	}	
 }
 
-void aes_gcm::encryptandsign (	const uint8_t *pt, 
+// Derives H = E(0) and its GHASH table, once per key
+template <class block_cipher>
+void gcm_mode<block_cipher>::init_keys (const uint8_t *key_bytes) {
+	block_cipher::init_keys(key_bytes);
+
+	std::memset(h,0,16);
+	this->encrypt_block(h,h);
+	gf2_128_math::ghash_init(h_tbl,h);
+}
+
+// len(a) || len(c) block, followed by the final GHASH step and E(J0)
+template <class block_cipher>
+void gcm_mode<block_cipher>::finish_tag (uint8_t *tag, const uint8_t *cntr0_enc, uint64_t num_aad_bytes, uint64_t num_pt_bytes) {
+	uint8_t len[16];
+
+	uint64_t len_ct  = num_pt_bytes * 8;
+	uint64_t len_aad = num_aad_bytes * 8;
+	for(int i=0;i<8;i++) {
+		len[15-i] = uint8_t (len_ct >> (8*i));
+		len[7-i]  = uint8_t (len_aad >> (8*i));
+	}
+
+	gf2_128_math::xor_acc(tag,len);
+	gf2_128_math::ghash_mult(tag,h_tbl);
+	gf2_128_math::xor_acc(tag,cntr0_enc);
+}
+
+template <class block_cipher>
+void gcm_mode<block_cipher>::encryptandsign (	const uint8_t *pt, 
 								const uint8_t *aad, 
 								const uint8_t *iv, 
 								uint8_t *ct, 
@@ -532,102 +584,33 @@ void aes_gcm::encryptandsign (	const uint8_t *pt,
 							) 
 {
 
-	uint8_t cntr[16],cntr_enc[16];
+	uint8_t cntr[16];
 	
 	std::memcpy(cntr,iv,12);
 	std::memset(cntr+12,0,4);
 	
 	cntr[15] = 0x1;
 	uint8_t cntr0_enc[16];
-	encrypt_block(cntr,cntr0_enc);
+	this->encrypt_block(cntr,cntr0_enc);
 	
-	//uint8_t tag[16];
 	std::memset(tag,0,16);
+	gf2_128_math::ghash(tag,h_tbl,aad,num_aad_bytes);
 	
-	uint8_t h[16];
-	std::memset(h,0,16);
-	encrypt_block(h,h);
-	
-	int num_full_aad_blocks   = num_aad_bytes/16;
-	int num_partial_aad_bytes = num_aad_bytes%16;
-	
-	int num_full_pt_blocks 		= num_pt_bytes/16;
-	int num_partial_pt_bytes	= num_pt_bytes%16;
-	
-	for(int i=0; i<num_full_aad_blocks; i++) {
-		uint8_t newtag[16];
-		gf2_128_math::xor_acc(tag,aad+i*16);
-		gf2_128_math::mult_gmac(newtag, tag ,h);
-		std::memcpy(tag,newtag,16);
-	}
+	incr_cntr(cntr);
 
-	if (num_partial_aad_bytes > 0) {
-		uint8_t temp[16];
-		std::memcpy(temp,aad+(num_full_aad_blocks*16),num_partial_aad_bytes);
-		std::memset(temp+num_partial_aad_bytes,0,16-num_partial_aad_bytes);
-		gf2_128_math::xor_acc(tag,temp);
-		gf2_128_math::mult_gmac(temp,tag,h);
-		std::memcpy(tag,temp,16);
+	// CTR a batch of blocks, then GHASH them while still in cache
+	for(int i=0;i<num_pt_bytes;i+=AES_MAX_BLOCKS*16) {
+		int len = std::min(AES_MAX_BLOCKS*16, num_pt_bytes-i);
+		ctr_xor(ct+i,pt+i,cntr,len);
+		gf2_128_math::ghash(tag,h_tbl,ct+i,len);
 	}
 
-	for(int i=0;i<num_full_pt_blocks;i++) {
-		
-		// increment cntr
-		incr_cntr(cntr);
-		encrypt_block(cntr,cntr_enc);
-	
-		for (int j=0;j<16;j++) 
-			ct[i*16+j] = pt[i*16+j] ^ cntr_enc[j];
-	
-		gf2_128_math::xor_acc(tag,ct+i*16);
-		
-		gf2_128_math::mult_gmac(tag,tag,h);
-		
-	}
-
-	if (num_partial_pt_bytes > 0) {
-		uint8_t partial_ct_block[16];
-		
-		incr_cntr(cntr);
-		encrypt_block(cntr,cntr_enc);
-		
-		for (int j=0;j<num_partial_pt_bytes;j++) 
-			partial_ct_block[j] = pt[num_full_pt_blocks*16+j] ^ cntr_enc[j];
-		
-		std::memcpy(ct+num_full_pt_blocks*16,partial_ct_block,num_partial_pt_bytes);
-		std::memset(partial_ct_block+num_partial_pt_bytes,0,16-num_partial_pt_bytes);
-
-		
-		gf2_128_math::xor_acc(tag,partial_ct_block);
-		gf2_128_math::mult_gmac(tag,tag,h);
-
-	}
-
-	uint8_t len[16];
-	std::memset(len,0,16);
-	
-	// len(a) || len(c)
-	unsigned int len_ct =  num_pt_bytes * 8;
-	unsigned int len_aad = num_aad_bytes * 8;
-	len[15] = uint8_t ( len_ct & 0xFF);
-	len[14] = uint8_t ((len_ct & 0xFFFF) >> 8);
-	len[13] = uint8_t ((len_ct & 0xFFFFFF) >> 16);
-	len[12] = uint8_t (len_ct >> 24);
-	
-	len[7] = uint8_t ( len_aad & 0xFF);
-	len[6] = uint8_t ((len_aad & 0xFFFF) >> 8);
-	len[5] = uint8_t ((len_aad & 0xFFFFFF) >> 16);
-	len[4] = uint8_t (len_aad >> 24);
-	
-	
-	gf2_128_math::xor_acc(tag, len);
-	gf2_128_math::mult_gmac(tag,tag,h);
-	
-	gf2_128_math::xor_acc(tag,cntr0_enc);
+	finish_tag(tag,cntr0_enc,num_aad_bytes,num_pt_bytes);
 	
 }
 
-bool aes_gcm::decryptandverify (	uint8_t *pt, 
+template <class block_cipher>
+bool gcm_mode<block_cipher>::decryptandverify (	uint8_t *pt, 
 									const uint8_t *aad, 
 									const uint8_t *iv, 
 									const uint8_t *ct, 
@@ -636,115 +619,965 @@ bool aes_gcm::decryptandverify (	uint8_t *pt,
 									int num_pt_bytes
 							) 
 {
-	uint8_t cntr[16],cntr_enc[16],calc_tag[16];
-	
-	int num_full_aad_blocks 	= num_aad_bytes/16;
-	int num_partial_aad_bytes	= num_aad_bytes%16;
-	
-	int num_full_pt_blocks		= num_pt_bytes/16;
-	int num_partial_pt_bytes	= num_pt_bytes%16;
+	uint8_t cntr[16],calc_tag[16];
 	
 	std::memcpy(cntr,iv,12);
 	std::memset(cntr+12,0,4);
 	
 	cntr[15] = 0x1;
 	uint8_t cntr0_enc[16];
-	encrypt_block(cntr,cntr0_enc);
+	this->encrypt_block(cntr,cntr0_enc);
 	
 	// Verify
 	std::memset(calc_tag,0,16);
+	gf2_128_math::ghash(calc_tag,h_tbl,aad,num_aad_bytes);
+	gf2_128_math::ghash(calc_tag,h_tbl,ct,num_pt_bytes);
+	finish_tag(calc_tag,cntr0_enc,num_aad_bytes,num_pt_bytes);
+								
+	bool tagv_res = tag_equal(calc_tag,tag,16);
 	
-	uint8_t h[16];
-	std::memset(h,0,16);
-	encrypt_block(h,h);
+	if (tagv_res == false) {
+		std::memset(pt,0,num_pt_bytes);
+		return false;
+	}
+	
+	incr_cntr(cntr);
+	ctr_xor(pt,ct,cntr,num_pt_bytes);
 	
-	for(int i=0; i<num_full_aad_blocks; i++) {
-		uint8_t newtag[16];
-		gf2_128_math::xor_acc(calc_tag,aad+i*16);
-		gf2_128_math::mult_gmac(newtag, calc_tag ,h);
-		std::memcpy(calc_tag,newtag,16);
+	return true;
+}
+
+// CTR over num_bytes, AES_MAX_BLOCKS counter blocks are ciphered at a time
+// cntr is the counter of the first block, left at the next unused one
+template <class block_cipher>
+void gcm_mode<block_cipher>::ctr_xor (uint8_t *dst, const uint8_t *src, uint8_t *cntr, int num_bytes) {
+	uint8_t cntr_blks[AES_MAX_BLOCKS][16];
+
+	for(int i=0;i<num_bytes;i+=AES_MAX_BLOCKS*16) {
+		int len = std::min(AES_MAX_BLOCKS*16, num_bytes-i);
+		int n = (len+15)/16;
+
+		for(int b=0;b<n;b++) {
+			std::memcpy(cntr_blks[b],cntr,16);
+			incr_cntr(cntr);
+		}
+
+		this->encrypt_blocks(cntr_blks[0],cntr_blks[0],n);
+
+		for(int j=0;j<len;j++)
+			dst[i+j] = src[i+j] ^ cntr_blks[j/16][j%16];
 	}
+}
+
+// Adds n to the 128 bit counter, same wrap around behaviour as incr_cntr
+template <class block_cipher>
+void gcm_mode<block_cipher>::add_cntr(uint8_t *cntr, uint32_t n) {
+	uint64_t temp = n;
+	for(int k=15;k>=0 && temp;k--) {
+		temp += cntr[k];
+		cntr[k] = uint8_t (temp);
+		temp >>= 8;
+	}
+}
+
+/****************************************************************
+	AES GCM - Batch API for many small packets under one key
+
+	Packets are processed GCM_BATCH_LANES at a time, one block
+	from each packet per step. Counter blocks of all lanes are
+	encrypted back to back and GHASH chains of the lanes are
+	independent of each other, so neither stalls the other.
+****************************************************************/
+
+template <class block_cipher>
+void gcm_mode<block_cipher>::encryptandsign_batch (gcm_packet *pkts, int num_pkts) {
+	for(int i=0; i<num_pkts; i+=GCM_BATCH_LANES)
+		process_lanes(pkts+i, std::min(GCM_BATCH_LANES, num_pkts-i), true);
+}
+
+// Returns true only if all packets are authentic, is_valid is set per packet
+template <class block_cipher>
+bool gcm_mode<block_cipher>::decryptandverify_batch (gcm_packet *pkts, int num_pkts) {
+	for(int i=0; i<num_pkts; i+=GCM_BATCH_LANES)
+		process_lanes(pkts+i, std::min(GCM_BATCH_LANES, num_pkts-i), false);
 
-	if (num_partial_aad_bytes > 0) {
+	bool all_valid = true;
+	for(int i=0; i<num_pkts; i++)
+		all_valid &= pkts[i].is_valid;
+
+	return all_valid;
+}
+
+template <class block_cipher>
+void gcm_mode<block_cipher>::process_lanes (gcm_packet *pkts, int num_lanes, bool is_encrypt) {
+	uint8_t cntr[GCM_BATCH_LANES][16], cntr0_enc[GCM_BATCH_LANES][16];
+	uint8_t cntr_enc[GCM_BATCH_LANES][16], acc[GCM_BATCH_LANES][16];
+
+	int max_aad_blocks = 0, max_pt_blocks = 0;
+
+	for(int l=0; l<num_lanes; l++) {
+		std::memcpy(cntr[l],pkts[l].iv,12);
+		std::memset(cntr[l]+12,0,4);
+		cntr[l][15] = 0x1;
+		std::memset(acc[l],0,16);
+
+		max_aad_blocks = std::max(max_aad_blocks, (pkts[l].num_aad_bytes+15)/16);
+		max_pt_blocks  = std::max(max_pt_blocks,  (pkts[l].num_pt_bytes+15)/16);
+	}
+
+	this->encrypt_blocks(cntr[0],cntr0_enc[0],num_lanes);
+	for(int l=0; l<num_lanes; l++)
+		incr_cntr(cntr[l]);
+
+	for(int b=0; b<max_aad_blocks; b++) {
+		for(int l=0; l<num_lanes; l++) {
+			int len = std::min(16, pkts[l].num_aad_bytes - b*16);
+			if (len > 0)
+				gf2_128_math::ghash(acc[l],h_tbl,pkts[l].aad+b*16,len);
+		}
+	}
+
+	for(int b=0; b<max_pt_blocks; b++) {
+		int n = 0;
+		for(int l=0; l<num_lanes; l++) {
+			if (b*16 < pkts[l].num_pt_bytes) {
+				std::memcpy(cntr_enc[n++],cntr[l],16);
+				incr_cntr(cntr[l]);
+			}
+		}
+
+		this->encrypt_blocks(cntr_enc[0],cntr_enc[0],n);
+
+		n = 0;
+		for(int l=0; l<num_lanes; l++) {
+			int len = std::min(16, pkts[l].num_pt_bytes - b*16);
+			if (len <= 0)
+				continue;
+
+			const uint8_t *src 	= is_encrypt ? pkts[l].pt : pkts[l].ct;
+			uint8_t *dst 		= is_encrypt ? pkts[l].ct : pkts[l].pt;
+			for(int j=0; j<len; j++)
+				dst[b*16+j] = src[b*16+j] ^ cntr_enc[n][j];
+			n++;
+
+			gf2_128_math::ghash(acc[l],h_tbl,pkts[l].ct+b*16,len);
+		}
+	}
+
+	for(int l=0; l<num_lanes; l++) {
+		finish_tag(acc[l],cntr0_enc[l],pkts[l].num_aad_bytes,pkts[l].num_pt_bytes);
+
+		if (is_encrypt) {
+			std::memcpy(pkts[l].tag,acc[l],16);
+			pkts[l].is_valid = true;
+		} else {
+			pkts[l].is_valid = tag_equal(acc[l],pkts[l].tag,16);
+			if (!pkts[l].is_valid)
+				std::memset(pkts[l].pt,0,pkts[l].num_pt_bytes);
+		}
+	}
+}
+
+/****************************************************************
+	AES GMAC - Authentication only
+****************************************************************/
+
+template <class block_cipher>
+gmac_mode<block_cipher>::gmac_mode(int key_sz) : gcm_mode<block_cipher> (key_sz) {
+}
+
+template <class block_cipher>
+void gmac_mode<block_cipher>::init (const uint8_t *iv) {
+	uint8_t cntr[16];
+	std::memcpy(cntr,iv,12);
+	std::memset(cntr+12,0,4);
+	cntr[15] = 0x1;
+	this->encrypt_block(cntr,cntr0_enc);
+
+	std::memset(acc,0,16);
+	num_buf_bytes = 0;
+	num_total_bytes = 0;
+}
+
+template <class block_cipher>
+void gmac_mode<block_cipher>::update (const uint8_t *aad, int num_aad_bytes) {
+	num_total_bytes += num_aad_bytes;
+
+	// Top up block left over from the last update
+	if (num_buf_bytes > 0) {
+		int n = std::min(16-num_buf_bytes, num_aad_bytes);
+		std::memcpy(buf+num_buf_bytes,aad,n);
+		num_buf_bytes += n;
+		aad += n;
+		num_aad_bytes -= n;
+
+		if (num_buf_bytes < 16)
+			return;
+
+		gf2_128_math::xor_acc(acc,buf);
+		gf2_128_math::ghash_mult(acc,this->h_tbl);
+		num_buf_bytes = 0;
+	}
+
+	int num_full_bytes = num_aad_bytes - num_aad_bytes%16;
+	gf2_128_math::ghash(acc,this->h_tbl,aad,num_full_bytes);
+
+	num_buf_bytes = num_aad_bytes%16;
+	std::memcpy(buf,aad+num_full_bytes,num_buf_bytes);
+}
+
+template <class block_cipher>
+void gmac_mode<block_cipher>::final (uint8_t *tag) {
+	gf2_128_math::ghash(acc,this->h_tbl,buf,num_buf_bytes);
+	this->finish_tag(acc,cntr0_enc,num_total_bytes,0);
+	std::memcpy(tag,acc,16);
+}
+
+template <class block_cipher>
+void gmac_mode<block_cipher>::sign (const uint8_t *aad, const uint8_t *iv, uint8_t *tag, int num_aad_bytes) {
+	init(iv);
+	update(aad,num_aad_bytes);
+	final(tag);
+}
+
+template <class block_cipher>
+bool gmac_mode<block_cipher>::verify (const uint8_t *aad, const uint8_t *iv, const uint8_t *tag, int num_aad_bytes) {
+	uint8_t calc_tag[16];
+	sign(aad,iv,calc_tag,num_aad_bytes);
+	return tag_equal(calc_tag,tag,16);
+}
+
+/****************************************************************
+	AES OCB3 - Offset Codebook Mode (RFC 7253)
+
+	C_i = Offset_i ^ E(P_i ^ Offset_i),  Offset_i = Offset_i-1 ^ L_ntz(i)
+	Tag = E(Checksum ^ Offset_m ^ L_$) ^ HASH(A)
+	Offsets only depend on the block index, so blocks are whitened,
+	ciphered and unwhitened OCB_BATCH_BLOCKS at a time.
+****************************************************************/
+
+// Multiply by x in GF(2^128), MSB first bit order as used by OCB and CMAC
+static void block_double (uint8_t *dst, const uint8_t *src) {
+	uint8_t carry = src[0] >> 7;
+	for(int i=0;i<15;i++)
+		dst[i] = (src[i] << 1) | (src[i+1] >> 7);
+	dst[15] = (src[15] << 1) ^ (carry ? 0x87 : 0);
+}
+
+static int ntz (uint32_t i) {
+	return __builtin_ctz(i);
+}
+
+template <class block_cipher>
+ocb_mode<block_cipher>::ocb_mode(int key_sz, int tag_bytes, int nonce_bytes) : block_cipher (key_sz) {
+	if (tag_bytes < 1 || tag_bytes > 16 || nonce_bytes < 1 || nonce_bytes > 15) {
+		std::cout << "Error: Illegal OCB tag/nonce size" << std::endl;
+		std::exit(-1);
+	}
+
+	this->tag_bytes = tag_bytes;
+	this->nonce_bytes = nonce_bytes;
+}
+
+// L_* = E(0), L_$ = double(L_*), L_0 = double(L_$), L_i = double(L_i-1)
+template <class block_cipher>
+void ocb_mode<block_cipher>::init_keys (const uint8_t *key_bytes) {
+	block_cipher::init_keys(key_bytes);
+
+	std::memset(l_star,0,16);
+	this->encrypt_block(l_star,l_star);
+	block_double(l_dollar,l_star);
+	block_double(l[0],l_dollar);
+
+	for(int i=1;i<OCB_NUM_L;i++)
+		block_double(l[i],l[i-1]);
+}
+
+// Offset_0 from the nonce
+// Nonce block = taglen mod 128 (7 bits) || 0* || 1 || N
+// Offset_0 = (Ktop || Ktop[1..64] ^ Ktop[9..72]) [1+bottom .. 128+bottom]
+template <class block_cipher>
+void ocb_mode<block_cipher>::init_offset (uint8_t *offset, const uint8_t *nonce) {
+	uint8_t nonce_blk[16], ktop[16], stretch[24];
+
+	std::memset(nonce_blk,0,16);
+	nonce_blk[0] = uint8_t (((tag_bytes*8) % 128) << 1);
+	nonce_blk[15-nonce_bytes] |= 0x01;
+	std::memcpy(nonce_blk+16-nonce_bytes,nonce,nonce_bytes);
+
+	int bottom = nonce_blk[15] & 0x3F;
+	nonce_blk[15] &= 0xC0;
+	this->encrypt_block(nonce_blk,ktop);
+
+	std::memcpy(stretch,ktop,16);
+	for(int i=0;i<8;i++)
+		stretch[16+i] = ktop[i] ^ ktop[i+1];
+
+	int byte_shift = bottom/8, bit_shift = bottom%8;
+	for(int i=0;i<16;i++) {
+		offset[i] = stretch[i+byte_shift] << bit_shift;
+		if (bit_shift)
+			offset[i] |= stretch[i+byte_shift+1] >> (8-bit_shift);
+	}
+}
+
+// HASH(K,A) - Sum of E(A_i ^ Offset_i), offsets start from zero
+template <class block_cipher>
+void ocb_mode<block_cipher>::hash (uint8_t *sum, const uint8_t *aad, int num_aad_bytes) {
+	uint8_t offset[16], blks[OCB_BATCH_BLOCKS][16];
+
+	int num_full_blocks 	= num_aad_bytes/16;
+	int num_partial_bytes	= num_aad_bytes%16;
+
+	std::memset(sum,0,16);
+	std::memset(offset,0,16);
+
+	for(int base=0; base<num_full_blocks; base+=OCB_BATCH_BLOCKS) {
+		int n = std::min(OCB_BATCH_BLOCKS, num_full_blocks-base);
+
+		for(int k=0; k<n; k++) {
+			gf2_128_math::xor_acc(offset,l[ntz(base+k+1)]);
+			for(int j=0;j<16;j++)
+				blks[k][j] = aad[(base+k)*16+j] ^ offset[j];
+		}
+
+		this->encrypt_blocks(blks[0],blks[0],n);
+
+		for(int k=0; k<n; k++)
+			gf2_128_math::xor_acc(sum,blks[k]);
+	}
+
+	if (num_partial_bytes > 0) {
 		uint8_t temp[16];
-		std::memcpy(temp,aad+(num_full_aad_blocks*16),num_partial_aad_bytes);
-		std::memset(temp+num_partial_aad_bytes,0,16-num_partial_aad_bytes);
-		gf2_128_math::xor_acc(calc_tag,temp);
-		gf2_128_math::mult_gmac(calc_tag,calc_tag,h);
+		gf2_128_math::xor_acc(offset,l_star);
+
+		std::memset(temp,0,16);
+		std::memcpy(temp,aad+num_full_blocks*16,num_partial_bytes);
+		temp[num_partial_bytes] = 0x80;
+		gf2_128_math::xor_acc(temp,offset);
+
+		this->encrypt_block(temp,temp);
+		gf2_128_math::xor_acc(sum,temp);
 	}
-	
-	for(int i=0;i<num_full_pt_blocks;i++) {
-	
-		gf2_128_math::xor_acc(calc_tag,ct+i*16);
-		gf2_128_math::mult_gmac(calc_tag,calc_tag,h);
-		
+}
+
+// Tag = E(Checksum ^ Offset ^ L_$) ^ HASH(A), checksum is clobbered
+template <class block_cipher>
+void ocb_mode<block_cipher>::calc_tag (uint8_t *tag, uint8_t *checksum, const uint8_t *offset, const uint8_t *aad, int num_aad_bytes) {
+	uint8_t sum[16];
+
+	gf2_128_math::xor_acc(checksum,offset);
+	gf2_128_math::xor_acc(checksum,l_dollar);
+	this->encrypt_block(checksum,tag);
+
+	hash(sum,aad,num_aad_bytes);
+	gf2_128_math::xor_acc(tag,sum);
+}
+
+template <class block_cipher>
+void ocb_mode<block_cipher>::encryptandsign (	const uint8_t *pt,
+								const uint8_t *aad,
+								const uint8_t *nonce,
+								uint8_t *ct,
+								uint8_t *tag,
+								int num_aad_bytes,
+								int num_pt_bytes
+							)
+{
+	uint8_t offset[16], checksum[16], full_tag[16];
+	uint8_t offsets[OCB_BATCH_BLOCKS][16], blks[OCB_BATCH_BLOCKS][16];
+
+	int num_full_blocks 	= num_pt_bytes/16;
+	int num_partial_bytes	= num_pt_bytes%16;
+
+	init_offset(offset,nonce);
+	std::memset(checksum,0,16);
+
+	for(int base=0; base<num_full_blocks; base+=OCB_BATCH_BLOCKS) {
+		int n = std::min(OCB_BATCH_BLOCKS, num_full_blocks-base);
+
+		for(int k=0; k<n; k++) {
+			const uint8_t *p = pt+(base+k)*16;
+			gf2_128_math::xor_acc(offset,l[ntz(base+k+1)]);
+			std::memcpy(offsets[k],offset,16);
+			gf2_128_math::xor_acc(checksum,p);
+			for(int j=0;j<16;j++)
+				blks[k][j] = p[j] ^ offset[j];
+		}
+
+		this->encrypt_blocks(blks[0],blks[0],n);
+
+		for(int k=0; k<n; k++)
+			for(int j=0;j<16;j++)
+				ct[(base+k)*16+j] = blks[k][j] ^ offsets[k][j];
 	}
-	
-	if (num_partial_pt_bytes > 0) {
-		uint8_t partial_ct_block[16];
-		
-		std::memcpy(partial_ct_block,ct+num_full_pt_blocks*16,num_partial_pt_bytes);
-		std::memset(partial_ct_block+num_partial_pt_bytes,0,16-num_partial_pt_bytes);
-		
-		gf2_128_math::xor_acc(calc_tag,partial_ct_block);
-		gf2_128_math::mult_gmac(calc_tag,calc_tag,h);
 
+	if (num_partial_bytes > 0) {
+		uint8_t pad[16];
+		const uint8_t *p = pt+num_full_blocks*16;
+
+		gf2_128_math::xor_acc(offset,l_star);
+		this->encrypt_block(offset,pad);
+
+		for(int j=0;j<num_partial_bytes;j++) {
+			ct[num_full_blocks*16+j] = p[j] ^ pad[j];
+			checksum[j] ^= p[j];
+		}
+		checksum[num_partial_bytes] ^= 0x80;
 	}
-	
-	uint8_t len[16];
-	std::memset(len,0,16);
-	
-	// len(a) || len(c)
-	unsigned int len_ct =  num_pt_bytes * 8;
-	unsigned int len_aad = num_aad_bytes * 8;
-	len[15] = uint8_t ( len_ct & 0xFF);
-	len[14] = uint8_t ((len_ct & 0xFFFF) >> 8);
-	len[13] = uint8_t ((len_ct & 0xFFFFFF) >> 16);
-	len[12] = uint8_t (len_ct >> 24);
-	
-	len[7] = uint8_t ( len_aad & 0xFF);
-	len[6] = uint8_t ((len_aad & 0xFFFF) >> 8);
-	len[5] = uint8_t ((len_aad & 0xFFFFFF) >> 16);
-	len[4] = uint8_t (len_aad >> 24);
-	
-	gf2_128_math::xor_acc(calc_tag, len);
-	gf2_128_math::mult_gmac(calc_tag,calc_tag,h);
-	
-	gf2_128_math::xor_acc(calc_tag,cntr0_enc);
-								
-	bool tagv_res =  std::memcmp(calc_tag,tag,16) == 0;
-	
-	uint8_t l_pt [num_pt_bytes];
-	
-	for(int i=0;i<num_full_pt_blocks;i++) {
-		
+
+	calc_tag(full_tag,checksum,offset,aad,num_aad_bytes);
+	std::memcpy(tag,full_tag,tag_bytes);
+}
+
+template <class block_cipher>
+bool ocb_mode<block_cipher>::decryptandverify (	uint8_t *pt,
+									const uint8_t *aad,
+									const uint8_t *nonce,
+									const uint8_t *ct,
+									const uint8_t *tag,
+									int num_aad_bytes,
+									int num_pt_bytes
+								)
+{
+	uint8_t offset[16], checksum[16], calc_tag_buf[16];
+	uint8_t offsets[OCB_BATCH_BLOCKS][16], blks[OCB_BATCH_BLOCKS][16];
+
+	int num_full_blocks 	= num_pt_bytes/16;
+	int num_partial_bytes	= num_pt_bytes%16;
+
+	init_offset(offset,nonce);
+	std::memset(checksum,0,16);
+
+	for(int base=0; base<num_full_blocks; base+=OCB_BATCH_BLOCKS) {
+		int n = std::min(OCB_BATCH_BLOCKS, num_full_blocks-base);
+
+		for(int k=0; k<n; k++) {
+			const uint8_t *c = ct+(base+k)*16;
+			gf2_128_math::xor_acc(offset,l[ntz(base+k+1)]);
+			std::memcpy(offsets[k],offset,16);
+			for(int j=0;j<16;j++)
+				blks[k][j] = c[j] ^ offset[j];
+		}
+
+		this->decrypt_blocks(blks[0],blks[0],n);
+
+		for(int k=0; k<n; k++) {
+			uint8_t *p = pt+(base+k)*16;
+			for(int j=0;j<16;j++)
+				p[j] = blks[k][j] ^ offsets[k][j];
+			gf2_128_math::xor_acc(checksum,p);
+		}
+	}
+
+	if (num_partial_bytes > 0) {
+		uint8_t pad[16];
+		uint8_t *p = pt+num_full_blocks*16;
+
+		gf2_128_math::xor_acc(offset,l_star);
+		this->encrypt_block(offset,pad);
+
+		for(int j=0;j<num_partial_bytes;j++) {
+			p[j] = ct[num_full_blocks*16+j] ^ pad[j];
+			checksum[j] ^= p[j];
+		}
+		checksum[num_partial_bytes] ^= 0x80;
+	}
+
+	calc_tag(calc_tag_buf,checksum,offset,aad,num_aad_bytes);
+
+	bool tagv_res = tag_equal(calc_tag_buf,tag,tag_bytes);
+
+	if (tagv_res == false)
+		std::memset(pt,0,num_pt_bytes);
+
+	return tagv_res;
+}
+
+/****************************************************************
+	AES CCM - Counter with CBC-MAC
+
+	B0 		= flags || nonce || len(P)
+	MAC 	= CBC-MAC(B0 || len(A) || A || P), zero padded blocks
+	A_i 	= (L-1) || nonce || i,  C_i = P_i ^ E(A_i)
+	Tag 	= MAC ^ E(A_0)
+	Every step ciphers one MAC block and one counter block, the
+	counter block does not depend on the chain and overlaps it.
+****************************************************************/
+
+template <class block_cipher>
+ccm_mode<block_cipher>::ccm_mode(int key_sz, int tag_bytes, int nonce_bytes) : block_cipher (key_sz) {
+	if (tag_bytes < 4 || tag_bytes > 16 || tag_bytes%2 || nonce_bytes < 7 || nonce_bytes > 13) {
+		std::cout << "Error: Illegal CCM tag/nonce size" << std::endl;
+		std::exit(-1);
+	}
+
+	this->tag_bytes = tag_bytes;
+	this->nonce_bytes = nonce_bytes;
+}
+
+// Counter lives in the last L = 15 - nonce_bytes bytes
+template <class block_cipher>
+void ccm_mode<block_cipher>::incr_cntr (uint8_t *cntr) {
+	INSTR_COUNT(INSTR_INCR_CNTR, 1);
+	for(int k=15;k>nonce_bytes;k--) {
+		if(++cntr[k] != 0)
+			break;
+	}
+}
+
+// MACs B0 and the encoded aad, sets up A_1 in cntr and E(A_0) in cntr0_enc
+template <class block_cipher>
+void ccm_mode<block_cipher>::init_mac (	uint8_t *mac,
+							uint8_t *cntr,
+							uint8_t *cntr0_enc,
+							const uint8_t *nonce,
+							const uint8_t *aad,
+							int num_aad_bytes,
+							int num_pt_bytes
+						)
+{
+	int l = 15 - nonce_bytes;
+
+	if (l < 4 && (uint64_t) num_pt_bytes >> (8*l)) {
+		std::cout << "Error: CCM message too long for nonce size" << std::endl;
+		std::exit(-1);
+	}
+
+	// B0
+	mac[0] = (num_aad_bytes > 0 ? 0x40 : 0) | (((tag_bytes-2)/2) << 3) | (l-1);
+	std::memcpy(mac+1,nonce,nonce_bytes);
+	for(int i=0;i<l;i++)
+		mac[15-i] = i < 4 ? uint8_t (num_pt_bytes >> (8*i)) : 0;
+
+	// A_0
+	std::memset(cntr,0,16);
+	cntr[0] = l-1;
+	std::memcpy(cntr+1,nonce,nonce_bytes);
+
+	uint8_t pair[2][16];
+	std::memcpy(pair[0],mac,16);
+	std::memcpy(pair[1],cntr,16);
+	this->encrypt_blocks(pair[0],pair[0],2);
+	std::memcpy(mac,pair[0],16);
+	std::memcpy(cntr0_enc,pair[1],16);
+	incr_cntr(cntr);
+
+	if (num_aad_bytes == 0)
+		return;
+
+	// len(A) - 2 bytes, or 0xFFFE followed by 4 bytes
+	uint8_t blk[16];
+	int pos;
+	std::memset(blk,0,16);
+
+	if (num_aad_bytes < 0xFF00) {
+		blk[0] = uint8_t (num_aad_bytes >> 8);
+		blk[1] = uint8_t (num_aad_bytes);
+		pos = 2;
+	} else {
+		blk[0] = 0xFF;
+		blk[1] = 0xFE;
+		for(int i=0;i<4;i++)
+			blk[2+i] = uint8_t (num_aad_bytes >> (24-8*i));
+		pos = 6;
+	}
+
+	for(int i=0; i<num_aad_bytes; i++) {
+		blk[pos++] = aad[i];
+		if (pos == 16) {
+			gf2_128_math::xor_acc(mac,blk);
+			this->encrypt_block(mac,mac);
+			std::memset(blk,0,16);
+			pos = 0;
+		}
+	}
+
+	if (pos > 0) {
+		gf2_128_math::xor_acc(mac,blk);
+		this->encrypt_block(mac,mac);
+	}
+}
+
+template <class block_cipher>
+void ccm_mode<block_cipher>::encryptandsign (	const uint8_t *pt,
+								const uint8_t *aad,
+								const uint8_t *nonce,
+								uint8_t *ct,
+								uint8_t *tag,
+								int num_aad_bytes,
+								int num_pt_bytes
+							)
+{
+	// MAC chain and counter block side by side, ciphered in one multi block call
+	uint8_t pair[2][16], cntr[16], cntr0_enc[16];
+	uint8_t *mac = pair[0], *cntr_enc = pair[1];
+
+	init_mac(mac,cntr,cntr0_enc,nonce,aad,num_aad_bytes,num_pt_bytes);
+
+	for(int i=0; i<num_pt_bytes; i+=16) {
+		int n = std::min(16, num_pt_bytes-i);
+
+		for(int j=0;j<n;j++)
+			mac[j] ^= pt[i+j];
+
+		std::memcpy(cntr_enc,cntr,16);
 		incr_cntr(cntr);
-		encrypt_block(cntr,cntr_enc);
-	
-		for (int j=0;j<16;j++) 
-			l_pt[i*16+j] = ct[i*16+j] ^ cntr_enc[j];
+		this->encrypt_blocks(pair[0],pair[0],2);
 
+		for(int j=0;j<n;j++)
+			ct[i+j] = pt[i+j] ^ cntr_enc[j];
 	}
-		
-	if (num_partial_pt_bytes > 0) {
-		
+
+	for(int j=0;j<tag_bytes;j++)
+		tag[j] = mac[j] ^ cntr0_enc[j];
+}
+
+template <class block_cipher>
+bool ccm_mode<block_cipher>::decryptandverify (	uint8_t *pt,
+									const uint8_t *aad,
+									const uint8_t *nonce,
+									const uint8_t *ct,
+									const uint8_t *tag,
+									int num_aad_bytes,
+									int num_pt_bytes
+								)
+{
+	uint8_t pair[2][16], cntr[16], cntr0_enc[16];
+	uint8_t *mac = pair[0], *cntr_enc = pair[1];
+
+	init_mac(mac,cntr,cntr0_enc,nonce,aad,num_aad_bytes,num_pt_bytes);
+
+	// Keystream runs one block ahead of the MAC chain, the MAC needs the plaintext
+	if (num_pt_bytes > 0) {
+		this->encrypt_block(cntr,cntr_enc);
 		incr_cntr(cntr);
-		encrypt_block(cntr,cntr_enc);
-		
-		uint8_t temp_pt[16];
-		
-		for (int j=0;j<num_partial_pt_bytes;j++) 
-			temp_pt[j] = ct[num_full_pt_blocks*16+j] ^ cntr_enc[j];
-		
-		
-		std::memcpy(l_pt+num_full_pt_blocks*16,temp_pt,num_partial_pt_bytes);
-		
 	}
-	
+
+	for(int i=0; i<num_pt_bytes; i+=16) {
+		int n = std::min(16, num_pt_bytes-i);
+
+		for(int j=0;j<n;j++) {
+			pt[i+j] = ct[i+j] ^ cntr_enc[j];
+			mac[j] ^= pt[i+j];
+		}
+
+		if (i+16 < num_pt_bytes) {
+			std::memcpy(cntr_enc,cntr,16);
+			incr_cntr(cntr);
+			this->encrypt_blocks(pair[0],pair[0],2);
+		} else {
+			this->encrypt_block(mac,mac);
+		}
+	}
+
+	uint8_t diff = 0;
+	for(int j=0;j<tag_bytes;j++)
+		diff |= tag[j] ^ mac[j] ^ cntr0_enc[j];
+
+	bool tagv_res = diff == 0;
+
+	if (tagv_res == false)
+		std::memset(pt,0,num_pt_bytes);
+
+	return tagv_res;
+}
+
+/****************************************************************
+	AES CMAC (RFC 4493, SP 800-38B)
+
+	CBC-MAC with the last block whitened by K1 (complete block)
+	or K2 (10* padded block), K1 = double(E(0)), K2 = double(K1).
+	The batch API runs CMAC_LANES independent chains in lockstep
+	so consecutive cipher calls never wait on each other.
+****************************************************************/
+
+template <class block_cipher>
+cmac_mode<block_cipher>::cmac_mode(int key_sz) : block_cipher (key_sz) {
+}
+
+template <class block_cipher>
+void cmac_mode<block_cipher>::init_keys (const uint8_t *key_bytes) {
+	block_cipher::init_keys(key_bytes);
+
+	uint8_t l[16];
+	std::memset(l,0,16);
+	this->encrypt_block(l,l);
+	block_double(k1,l);
+	block_double(k2,k1);
+}
+
+// Last block of a message, complete blocks get K1 and partial ones 10* padding and K2
+template <class block_cipher>
+void cmac_mode<block_cipher>::last_block (uint8_t *blk, const uint8_t *msg, int num_bytes) {
+	if (num_bytes == 16) {
+		for(int j=0;j<16;j++)
+			blk[j] = msg[j] ^ k1[j];
+	} else {
+		std::memset(blk,0,16);
+		std::memcpy(blk,msg,num_bytes);
+		blk[num_bytes] = 0x80;
+		gf2_128_math::xor_acc(blk,k2);
+	}
+}
+
+template <class block_cipher>
+void cmac_mode<block_cipher>::init () {
+	std::memset(mac,0,16);
+	num_buf_bytes = 0;
+}
+
+// Last block of the message has to be held back until final
+template <class block_cipher>
+void cmac_mode<block_cipher>::update (const uint8_t *msg, int num_bytes) {
+	while (num_bytes > 0) {
+		if (num_buf_bytes == 16) {
+			gf2_128_math::xor_acc(mac,buf);
+			this->encrypt_block(mac,mac);
+			num_buf_bytes = 0;
+		}
+
+		// Full blocks straight from the input, except a possible last one
+		while (num_buf_bytes == 0 && num_bytes > 16) {
+			gf2_128_math::xor_acc(mac,msg);
+			this->encrypt_block(mac,mac);
+			msg += 16;
+			num_bytes -= 16;
+		}
+
+		int n = std::min(16-num_buf_bytes, num_bytes);
+		std::memcpy(buf+num_buf_bytes,msg,n);
+		num_buf_bytes += n;
+		msg += n;
+		num_bytes -= n;
+	}
+}
+
+template <class block_cipher>
+void cmac_mode<block_cipher>::final (uint8_t *tag) {
+	uint8_t blk[16];
+	last_block(blk,buf,num_buf_bytes);
+	gf2_128_math::xor_acc(mac,blk);
+	this->encrypt_block(mac,tag);
+}
+
+template <class block_cipher>
+void cmac_mode<block_cipher>::sign (const uint8_t *msg, uint8_t *tag, int num_bytes) {
+	init();
+	update(msg,num_bytes);
+	final(tag);
+}
+
+template <class block_cipher>
+bool cmac_mode<block_cipher>::verify (const uint8_t *msg, const uint8_t *tag, int num_bytes) {
+	uint8_t calc_tag[16];
+	sign(msg,calc_tag,num_bytes);
+	return tag_equal(calc_tag,tag,16);
+}
+
+template <class block_cipher>
+void cmac_mode<block_cipher>::sign_batch (cmac_msg *msgs, int num_msgs) {
+	uint8_t macs[CMAC_LANES][16];
+
+	for(int base=0; base<num_msgs; base+=CMAC_LANES) {
+		cmac_msg *m = msgs+base;
+		int num_lanes = std::min(CMAC_LANES, num_msgs-base);
+		int max_blocks = 0;
+
+		for(int l=0; l<num_lanes; l++) {
+			std::memset(macs[l],0,16);
+			max_blocks = std::max(max_blocks, std::max(1, (m[l].num_bytes+15)/16));
+		}
+
+		for(int b=0; b<max_blocks; b++) {
+			for(int l=0; l<num_lanes; l++) {
+				int num_blocks = std::max(1, (m[l].num_bytes+15)/16);
+				if (b >= num_blocks)
+					continue;
+
+				if (b == num_blocks-1) {
+					uint8_t blk[16];
+					last_block(blk,m[l].msg+b*16,m[l].num_bytes-b*16);
+					gf2_128_math::xor_acc(macs[l],blk);
+				} else {
+					gf2_128_math::xor_acc(macs[l],m[l].msg+b*16);
+				}
+			}
+
+			// Chains still running are gathered for one multi block call
+			uint8_t blks[CMAC_LANES][16];
+			int lanes[CMAC_LANES], n = 0;
+
+			for(int l=0; l<num_lanes; l++) {
+				if (b < std::max(1, (m[l].num_bytes+15)/16)) {
+					std::memcpy(blks[n],macs[l],16);
+					lanes[n++] = l;
+				}
+			}
+
+			this->encrypt_blocks(blks[0],blks[0],n);
+
+			for(int k=0; k<n; k++)
+				std::memcpy(macs[lanes[k]],blks[k],16);
+		}
+
+		for(int l=0; l<num_lanes; l++)
+			std::memcpy(m[l].tag,macs[l],16);
+	}
+}
+
+/****************************************************************
+	AES GCM - Multi threaded for large messages
+
+	GHASH is linear, for ciphertext split into chunks C1, C2 .. Cn
+	with P(Ci) as the GHASH of chunk Ci started from zero -
+		GHASH(C1 || C2) = GHASH(C1) * H^len(C2) + P(C2)
+	Each chunk gets its CTR and partial GHASH done on a separate
+	thread, partials are folded in order using Horner's rule.
+****************************************************************/
+
+template <class block_cipher>
+gcm_mt_mode<block_cipher>::gcm_mt_mode(int key_sz, int num_threads, int chunk_bytes) : gcm_mode<block_cipher> (key_sz), pool (num_threads) {
+	// Chunks have to be whole AES blocks to keep counter and GHASH aligned
+	this->chunk_bytes = std::max(16, chunk_bytes - chunk_bytes%16);
+}
+
+// One pass over all chunks in parallel
+// dst != nullptr 		- CTR src into dst, counter for 1st block is cntr1
+// partials != nullptr 	- GHASH of each chunk of ciphertext (dst if encrypting, else src)
+template <class block_cipher>
+void gcm_mt_mode<block_cipher>::chunk_pass (	uint8_t *dst,
+								const uint8_t *src,
+								const uint8_t *cntr1,
+								uint8_t *partials,
+								int num_bytes
+							)
+{
+	int num_chunks = (num_bytes + chunk_bytes - 1)/chunk_bytes;
+
+	pool.parallel_for(num_chunks, [&](int chunk) {
+		int offset 	= chunk*chunk_bytes;
+		int len 	= std::min(chunk_bytes, num_bytes - offset);
+
+		if (dst != nullptr) {
+			uint8_t cntr[16];
+			std::memcpy(cntr,cntr1,16);
+			this->add_cntr(cntr,offset/16);
+			this->ctr_xor(dst+offset,src+offset,cntr,len);
+		}
+
+		if (partials != nullptr) {
+			const uint8_t *ct = (dst != nullptr) ? dst : src;
+			std::memset(partials+chunk*16,0,16);
+			gf2_128_math::ghash(partials+chunk*16,this->h_tbl,ct+offset,len);
+		}
+	});
+}
+
+// tag = tag * H^len(chunk) + partial, for each chunk in order
+template <class block_cipher>
+void gcm_mt_mode<block_cipher>::fold_partials (uint8_t *tag, const uint8_t *partials, int num_bytes) {
+	int num_chunks 		= (num_bytes + chunk_bytes - 1)/chunk_bytes;
+	int last_chunk_bytes = num_bytes - (num_chunks-1)*chunk_bytes;
+
+	uint8_t h_chunk[16], h_last[16];
+	gf2_128_math::pow_gmac(h_chunk,this->h,chunk_bytes/16);
+	gf2_128_math::pow_gmac(h_last,this->h,(last_chunk_bytes+15)/16);
+
+	for(int i=0; i<num_chunks; i++) {
+		gf2_128_math::mult_gmac(tag,tag,(i == num_chunks-1) ? h_last : h_chunk);
+		gf2_128_math::xor_acc(tag,partials+i*16);
+	}
+}
+
+template <class block_cipher>
+void gcm_mt_mode<block_cipher>::encryptandsign (	const uint8_t *pt,
+									const uint8_t *aad,
+									const uint8_t *iv,
+									uint8_t *ct,
+									uint8_t *tag,
+									int num_aad_bytes,
+									int num_pt_bytes
+								)
+{
+	if (pool.size() == 1 || num_pt_bytes <= chunk_bytes) {
+		gcm_mode<block_cipher>::encryptandsign(pt,aad,iv,ct,tag,num_aad_bytes,num_pt_bytes);
+		return;
+	}
+
+	uint8_t cntr[16], cntr0_enc[16];
+
+	std::memcpy(cntr,iv,12);
+	std::memset(cntr+12,0,4);
+	cntr[15] = 0x1;
+	this->encrypt_block(cntr,cntr0_enc);
+	this->incr_cntr(cntr);
+
+	int num_chunks = (num_pt_bytes + chunk_bytes - 1)/chunk_bytes;
+	std::vector<uint8_t> partials(num_chunks*16);
+
+	chunk_pass(ct,pt,cntr,partials.data(),num_pt_bytes);
+
+	std::memset(tag,0,16);
+	gf2_128_math::ghash(tag,this->h_tbl,aad,num_aad_bytes);
+	fold_partials(tag,partials.data(),num_pt_bytes);
+	this->finish_tag(tag,cntr0_enc,num_aad_bytes,num_pt_bytes);
+}
+
+template <class block_cipher>
+bool gcm_mt_mode<block_cipher>::decryptandverify (	uint8_t *pt,
+									const uint8_t *aad,
+									const uint8_t *iv,
+									const uint8_t *ct,
+									const uint8_t *tag,
+									int num_aad_bytes,
+									int num_pt_bytes
+								)
+{
+	if (pool.size() == 1 || num_pt_bytes <= chunk_bytes)
+		return gcm_mode<block_cipher>::decryptandverify(pt,aad,iv,ct,tag,num_aad_bytes,num_pt_bytes);
+
+	uint8_t cntr[16], cntr0_enc[16], calc_tag[16];
+
+	std::memcpy(cntr,iv,12);
+	std::memset(cntr+12,0,4);
+	cntr[15] = 0x1;
+	this->encrypt_block(cntr,cntr0_enc);
+	this->incr_cntr(cntr);
+
+	int num_chunks = (num_pt_bytes + chunk_bytes - 1)/chunk_bytes;
+	std::vector<uint8_t> partials(num_chunks*16);
+
+	// Verify first, plaintext is released only for an authentic message
+	chunk_pass(nullptr,ct,cntr,partials.data(),num_pt_bytes);
+
+	std::memset(calc_tag,0,16);
+	gf2_128_math::ghash(calc_tag,this->h_tbl,aad,num_aad_bytes);
+	fold_partials(calc_tag,partials.data(),num_pt_bytes);
+	this->finish_tag(calc_tag,cntr0_enc,num_aad_bytes,num_pt_bytes);
+
+	bool tagv_res = tag_equal(calc_tag,tag,16);
+
 	if (tagv_res == true)
-		std::memcpy(pt,l_pt,num_pt_bytes);
-	else 
+		chunk_pass(pt,ct,cntr,nullptr,num_pt_bytes);
+	else
 		std::memset(pt,0,num_pt_bytes);
-	
+
 	return tagv_res;
 }
+
+/****************************************************************
+	Mode instantiations for each backend
+****************************************************************/
+
+template class ecb_mode<aes_block_cipher>;
+template class cbc_mode<aes_block_cipher>;
+template class cfb_mode<aes_block_cipher>;
+template class ofb_mode<aes_block_cipher>;
+template class ctr_mode<aes_block_cipher>;
+template class gcm_mode<aes_block_cipher>;
+template class gmac_mode<aes_block_cipher>;
+template class ocb_mode<aes_block_cipher>;
+template class ccm_mode<aes_block_cipher>;
+template class cmac_mode<aes_block_cipher>;
+template class gcm_mt_mode<aes_block_cipher>;
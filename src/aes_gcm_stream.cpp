@@ -0,0 +1,157 @@
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "aes_gcm_stream.h"
+
+static const uint8_t stream_magic[4] = {'L','C','G','S'};
+#define GCM_STREAM_VERSION 1
+
+static void put_be (uint8_t *out, uint64_t v, int num_bytes) {
+	for(int i=num_bytes-1; i>=0; i--, v>>=8)
+		out[i] = uint8_t (v);
+}
+
+static uint64_t get_be (const uint8_t *in, int num_bytes) {
+	uint64_t v = 0;
+	for(int i=0; i<num_bytes; i++)
+		v = (v << 8) | in[i];
+	return v;
+}
+
+/****************************************************************
+	Container header
+****************************************************************/
+
+uint64_t gcm_stream_header::num_chunks () const {
+	return pt_bytes == 0 ? 1 : (pt_bytes + chunk_bytes - 1) / chunk_bytes;
+}
+
+int gcm_stream_header::chunk_pt_bytes (uint64_t chunk) const {
+	return int (std::min<uint64_t>(chunk_bytes, pt_bytes - chunk*chunk_bytes));
+}
+
+uint64_t gcm_stream_header::chunk_offset (uint64_t chunk) const {
+	return GCM_STREAM_HEADER_BYTES + chunk*(chunk_bytes + GCM_STREAM_TAG_BYTES);
+}
+
+uint64_t gcm_stream_header::sealed_bytes () const {
+	return GCM_STREAM_HEADER_BYTES + pt_bytes + num_chunks()*GCM_STREAM_TAG_BYTES;
+}
+
+void gcm_stream_header::write (uint8_t *out) const {
+	std::memset(out, 0, GCM_STREAM_HEADER_BYTES);
+	std::memcpy(out, stream_magic, 4);
+	out[4] = GCM_STREAM_VERSION;
+	put_be(out+8, chunk_bytes, 4);
+	put_be(out+12, pt_bytes, 8);
+	std::memcpy(out+20, nonce_prefix, GCM_STREAM_PREFIX_BYTES);
+}
+
+bool gcm_stream_header::read (const uint8_t *in) {
+	if (std::memcmp(in, stream_magic, 4) != 0 || in[4] != GCM_STREAM_VERSION)
+		return false;
+
+	for(int i : {5, 6, 7, 27, 28, 29, 30, 31}) {
+		if (in[i] != 0)
+			return false;
+	}
+
+	chunk_bytes = uint32_t (get_be(in+8, 4));
+	pt_bytes 	= get_be(in+12, 8);
+	std::memcpy(nonce_prefix, in+20, GCM_STREAM_PREFIX_BYTES);
+
+	// Chunk size has to fit gcm_mode's int lengths, chunk count has to fit parallel_for
+	return chunk_bytes != 0 && chunk_bytes <= (1u << 30) && num_chunks() <= INT_MAX;
+}
+
+/****************************************************************
+	AES GCM stream
+****************************************************************/
+
+aes_gcm_stream::aes_gcm_stream (int key_sz, int chunk_bytes, int num_threads) : aes_gcm (key_sz), pool (num_threads) {
+	if (chunk_bytes <= 0 || chunk_bytes > (1 << 30)) {
+		std::cout << "Invalid chunk size " << chunk_bytes << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+	this->chunk_bytes = chunk_bytes;
+}
+
+uint64_t aes_gcm_stream::sealed_bytes (uint64_t pt_bytes) const {
+	gcm_stream_header h = {};
+	h.chunk_bytes = chunk_bytes;
+	h.pt_bytes = pt_bytes;
+	return h.sealed_bytes();
+}
+
+void aes_gcm_stream::chunk_iv_aad (uint8_t *iv, uint8_t *aad, const gcm_stream_header &h, uint64_t chunk) {
+	std::memcpy(iv, h.nonce_prefix, GCM_STREAM_PREFIX_BYTES);
+	put_be(iv+GCM_STREAM_PREFIX_BYTES, chunk, 4);
+	iv[11] = chunk == h.num_chunks()-1;
+
+	h.write(aad);
+	put_be(aad+GCM_STREAM_HEADER_BYTES, chunk, 8);
+}
+
+void aes_gcm_stream::seal (const uint8_t *pt, uint64_t pt_bytes, const uint8_t *nonce_prefix, uint8_t *out) {
+	gcm_stream_header h = {};
+	h.chunk_bytes = chunk_bytes;
+	h.pt_bytes = pt_bytes;
+	std::memcpy(h.nonce_prefix, nonce_prefix, GCM_STREAM_PREFIX_BYTES);
+
+	if (h.num_chunks() > INT_MAX) {
+		std::cout << "Too many chunks for a GCM stream" << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+
+	h.write(out);
+
+	pool.parallel_for(int (h.num_chunks()), [&](int chunk) {
+		uint8_t iv[12], aad[GCM_STREAM_HEADER_BYTES+8];
+		chunk_iv_aad(iv, aad, h, chunk);
+
+		int n = h.chunk_pt_bytes(chunk);
+		uint8_t *dst = out + h.chunk_offset(chunk);
+
+		encryptandsign(pt + uint64_t (chunk)*chunk_bytes, aad, iv, dst, dst+n, sizeof(aad), n);
+	});
+}
+
+bool aes_gcm_stream::open (uint8_t *pt, const uint8_t *in, uint64_t in_bytes) {
+	gcm_stream_header h;
+	if (in_bytes < GCM_STREAM_HEADER_BYTES || !h.read(in) || h.sealed_bytes() != in_bytes)
+		return false;
+
+	return open_chunks(pt, in, in + GCM_STREAM_HEADER_BYTES, 0, h.num_chunks());
+}
+
+bool aes_gcm_stream::open_chunks (uint8_t *pt, const uint8_t *hdr, const uint8_t *in, uint64_t first_chunk, uint64_t num_chunks) {
+	gcm_stream_header h;
+	if (!h.read(hdr) || first_chunk + num_chunks > h.num_chunks())
+		return false;
+
+	std::atomic<bool> all_valid(true);
+
+	pool.parallel_for(int (num_chunks), [&](int i) {
+		uint64_t chunk = first_chunk + i;
+		uint8_t iv[12], aad[GCM_STREAM_HEADER_BYTES+8];
+		chunk_iv_aad(iv, aad, h, chunk);
+
+		int n = h.chunk_pt_bytes(chunk);
+		const uint8_t *src = in + (h.chunk_offset(chunk) - h.chunk_offset(first_chunk));
+
+		if (!decryptandverify(pt + uint64_t (i)*h.chunk_bytes, aad, iv, src, src+n, sizeof(aad), n))
+			all_valid = false;
+	});
+
+	if (!all_valid) {
+		uint64_t last = first_chunk + num_chunks;
+		uint64_t end = last == h.num_chunks() ? h.pt_bytes : last*h.chunk_bytes;
+		std::memset(pt, 0, end - first_chunk*h.chunk_bytes);
+	}
+
+	return all_valid;
+}
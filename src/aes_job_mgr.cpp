@@ -0,0 +1,282 @@
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+#include "aes_job_mgr.h"
+
+aes_job_key::aes_job_key (int key_size, const uint8_t *key_bytes) : cipher (key_size), gcm (key_size) {
+	cipher.init_keys(key_bytes);
+	gcm.init_keys(key_bytes);
+}
+
+aes_job_mgr::aes_job_mgr (int batch_jobs, int max_latency_us) {
+	this->batch_jobs 	= std::max(1, batch_jobs);
+	this->max_latency 	= std::chrono::microseconds(max_latency_us);
+
+	dispatcher = std::thread(&aes_job_mgr::dispatch_loop, this);
+}
+
+aes_job_mgr::~aes_job_mgr () {
+	{
+		std::lock_guard<std::mutex> lk(mtx);
+		stop = true;
+	}
+	cv.notify_one();
+	dispatcher.join();
+}
+
+std::future<bool> aes_job_mgr::submit (const aes_job &job) {
+	pending_job p;
+	p.job = job;
+	std::future<bool> f = p.result.get_future();
+	enqueue(std::move(p));
+	return f;
+}
+
+void aes_job_mgr::submit (const aes_job &job, std::function<void(bool)> done) {
+	pending_job p;
+	p.job = job;
+	p.done = std::move(done);
+	enqueue(std::move(p));
+}
+
+void aes_job_mgr::enqueue (pending_job &&p) {
+	p.t_submit = clock::now();
+
+	bool wake;
+	{
+		std::lock_guard<std::mutex> lk(mtx);
+		queue.push_back(std::move(p));
+
+		// Dispatcher needs to know about a new deadline or a full batch
+		wake = queue.size() == 1 || (int) queue.size() >= batch_jobs;
+	}
+
+	if (wake)
+		cv.notify_one();
+}
+
+void aes_job_mgr::dispatch_loop () {
+	std::unique_lock<std::mutex> lk(mtx);
+
+	while (true) {
+		if (queue.empty()) {
+			if (stop)
+				return;
+			cv.wait(lk, [this] { return stop || !queue.empty(); });
+			continue;
+		}
+
+		// Wait for a full batch, but not past the oldest job's deadline
+		if ((int) queue.size() < batch_jobs && !stop)
+			cv.wait_until(lk, queue.front().t_submit + max_latency,
+				[this] { return stop || (int) queue.size() >= batch_jobs; });
+
+		std::vector<pending_job> batch;
+		int n = std::min((int) queue.size(), batch_jobs);
+		for(int i=0; i<n; i++) {
+			batch.push_back(std::move(queue.front()));
+			queue.pop_front();
+		}
+
+		lk.unlock();
+		run_batch(batch);
+		lk.lock();
+	}
+}
+
+void aes_job_mgr::run_batch (std::vector<pending_job> &batch) {
+
+	// Group by key and job type
+	std::vector<pending_job *> order;
+	for(auto &p : batch)
+		order.push_back(&p);
+
+	std::stable_sort(order.begin(), order.end(), [] (const pending_job *a, const pending_job *b) {
+		if (a->job.key != b->job.key)
+			return std::less<const aes_job_key *>()(a->job.key, b->job.key);
+		return a->job.type < b->job.type;
+	});
+
+	std::vector<bool> results;
+	std::vector<pending_job *> group;
+
+	for(size_t i=0; i<order.size(); ) {
+		size_t j = i;
+		group.clear();
+		while (j < order.size() && order[j]->job.key == order[i]->job.key && order[j]->job.type == order[i]->job.type)
+			group.push_back(order[j++]);
+
+		std::unique_ptr<bool[]> res(new bool[group.size()]);
+
+		switch (order[i]->job.type) {
+			case AES_JOB_ECB_ENC:
+			case AES_JOB_ECB_DEC:
+				run_ecb(group, res.get());
+				break;
+			case AES_JOB_CBC_ENC:
+			case AES_JOB_CBC_DEC:
+				run_cbc(group, res.get());
+				break;
+			case AES_JOB_CTR:
+				run_ctr(group, res.get());
+				break;
+			case AES_JOB_GCM_SEAL:
+			case AES_JOB_GCM_OPEN:
+				run_gcm(group, res.get());
+				break;
+		}
+
+		for(size_t k=0; k<group.size(); k++) {
+			if (group[k]->done)
+				group[k]->done(res[k]);
+			else
+				group[k]->result.set_value(res[k]);
+		}
+
+		i = j;
+	}
+}
+
+// All blocks of all jobs go through a single multi block call
+void aes_job_mgr::run_ecb (std::vector<pending_job *> &jobs, bool *res) {
+	aes_block_cipher &cipher = const_cast<aes_job_key *>(jobs[0]->job.key)->cipher;
+	bool is_encrypt = jobs[0]->job.type == AES_JOB_ECB_ENC;
+
+	std::vector<uint8_t> buf;
+	for(size_t i=0; i<jobs.size(); i++) {
+		const aes_job &j = jobs[i]->job;
+		res[i] = j.num_bytes % 16 == 0;
+		if (res[i])
+			buf.insert(buf.end(), j.src, j.src+j.num_bytes);
+	}
+
+	if (is_encrypt)
+		cipher.encrypt_blocks(buf.data(), buf.data(), buf.size()/16);
+	else
+		cipher.decrypt_blocks(buf.data(), buf.data(), buf.size()/16);
+
+	size_t offset = 0;
+	for(size_t i=0; i<jobs.size(); i++) {
+		if (!res[i])
+			continue;
+		std::memcpy(jobs[i]->job.dst, buf.data()+offset, jobs[i]->job.num_bytes);
+		offset += jobs[i]->job.num_bytes;
+	}
+}
+
+// Decryption is one multi block call over all jobs
+// Encryption is serial per job, so chains of up to AES_MAX_BLOCKS jobs advance in lockstep
+void aes_job_mgr::run_cbc (std::vector<pending_job *> &jobs, bool *res) {
+	aes_block_cipher &cipher = const_cast<aes_job_key *>(jobs[0]->job.key)->cipher;
+
+	for(size_t i=0; i<jobs.size(); i++)
+		res[i] = jobs[i]->job.num_bytes % 16 == 0;
+
+	if (jobs[0]->job.type == AES_JOB_CBC_DEC) {
+		std::vector<uint8_t> buf;
+		for(size_t i=0; i<jobs.size(); i++) {
+			if (res[i])
+				buf.insert(buf.end(), jobs[i]->job.src, jobs[i]->job.src+jobs[i]->job.num_bytes);
+		}
+
+		cipher.decrypt_blocks(buf.data(), buf.data(), buf.size()/16);
+
+		size_t offset = 0;
+		for(size_t i=0; i<jobs.size(); i++) {
+			if (!res[i])
+				continue;
+
+			const aes_job &j = jobs[i]->job;
+			for(int b=0; b<j.num_bytes; b++)
+				j.dst[b] = buf[offset+b] ^ (b < 16 ? j.iv[b] : j.src[b-16]);
+			offset += j.num_bytes;
+		}
+		return;
+	}
+
+	for(size_t base=0; base<jobs.size(); base+=AES_MAX_BLOCKS) {
+		int num_lanes = std::min((size_t) AES_MAX_BLOCKS, jobs.size()-base);
+		uint8_t blks[AES_MAX_BLOCKS][16];
+		int lanes[AES_MAX_BLOCKS];
+
+		for(int b=0; ; b++) {
+			int n = 0;
+			for(int l=0; l<num_lanes; l++) {
+				const aes_job &j = jobs[base+l]->job;
+				if (!res[base+l] || b*16 >= j.num_bytes)
+					continue;
+
+				const uint8_t *prev = b == 0 ? j.iv : j.dst+(b-1)*16;
+				for(int k=0; k<16; k++)
+					blks[n][k] = j.src[b*16+k] ^ prev[k];
+				lanes[n++] = l;
+			}
+
+			if (n == 0)
+				break;
+
+			cipher.encrypt_blocks(blks[0], blks[0], n);
+
+			for(int k=0; k<n; k++)
+				std::memcpy(jobs[base+lanes[k]]->job.dst+b*16, blks[k], 16);
+		}
+	}
+}
+
+// Counter blocks of all jobs are ciphered in one multi block call
+void aes_job_mgr::run_ctr (std::vector<pending_job *> &jobs, bool *res) {
+	aes_block_cipher &cipher = const_cast<aes_job_key *>(jobs[0]->job.key)->cipher;
+
+	std::vector<uint8_t> ks;
+	for(size_t i=0; i<jobs.size(); i++) {
+		const aes_job &j = jobs[i]->job;
+		uint8_t cntr[16];
+		std::memcpy(cntr, j.iv, 16);
+
+		for(int b=0; b<j.num_bytes; b+=16) {
+			ks.insert(ks.end(), cntr, cntr+16);
+
+			// 128 bit increment, same as ctr_mode
+			for(int k=15; k>=0; k--) {
+				if (++cntr[k] != 0)
+					break;
+			}
+		}
+		res[i] = true;
+	}
+
+	cipher.encrypt_blocks(ks.data(), ks.data(), ks.size()/16);
+
+	size_t offset = 0;
+	for(size_t i=0; i<jobs.size(); i++) {
+		const aes_job &j = jobs[i]->job;
+		for(int b=0; b<j.num_bytes; b++)
+			j.dst[b] = j.src[b] ^ ks[offset+b];
+		offset += (j.num_bytes+15)/16*16;
+	}
+}
+
+void aes_job_mgr::run_gcm (std::vector<pending_job *> &jobs, bool *res) {
+	aes_gcm &gcm = const_cast<aes_job_key *>(jobs[0]->job.key)->gcm;
+	bool is_seal = jobs[0]->job.type == AES_JOB_GCM_SEAL;
+
+	std::vector<gcm_packet> pkts;
+	for(auto p : jobs) {
+		const aes_job &j = p->job;
+		uint8_t *src = const_cast<uint8_t *>(j.src);
+
+		if (is_seal)
+			pkts.push_back({ j.iv, j.aad, src, j.dst, j.tag, j.num_aad_bytes, j.num_bytes, false });
+		else
+			pkts.push_back({ j.iv, j.aad, j.dst, src, j.tag, j.num_aad_bytes, j.num_bytes, false });
+	}
+
+	if (is_seal)
+		gcm.encryptandsign_batch(pkts.data(), pkts.size());
+	else
+		gcm.decryptandverify_batch(pkts.data(), pkts.size());
+
+	for(size_t i=0; i<pkts.size(); i++)
+		res[i] = pkts[i].is_valid;
+}
@@ -1,5 +1,13 @@
 
 #include <arith.h>
+#include <ctr_drbg.h>
+#include <limb64.h>
+#include <instrument.h>
+
+#include <algorithm>
+#include <list>
+#include <map>
+#include <mutex>
 
 // Constructor - Initialize with a integer val
 bigInt::bigInt() {
@@ -28,11 +36,13 @@ bigInt::bigInt(uint32_t val[], int size) {
 bigInt::~bigInt() {
 }
 
-// Randomize data
+// Randomize data from the per thread CTR_DRBG, the sign bit is cleared so the value stays positive
 void bigInt::randInit() {
-	for( auto &i : data) {
-		i = rand();
-	}
+	if (data.empty())
+		return;
+
+	ctr_drbg::local().fill(reinterpret_cast<uint8_t *>(data.data()), data.size()*sizeof(uint32_t));
+	data.back() &= 0x7FFFFFFF;
 }
 
 // Actual size used up by the underlying data
@@ -63,17 +73,22 @@ int bigInt::numBits() const {
 void bigInt::add (const bigInt &x, bool auto_upsize = true) {
 	
 	if(auto_upsize) {
-		int result_size = std::max(numWords(), x.numWords());
+		size_t result_size = std::max(numWords(), x.numWords());
 	
 		if(data.size() < result_size)
 			data.resize(result_size,(getSign() ? 0xFFFFFFFF : 0));
 	}
 	
+	// x may be *this, its sign and size are read before anything is written
+	bool x_sign = x.getSign();
+	uint32_t x_ext = x_sign ? 0xFFFFFFFF : 0;
+	size_t x_size = x.data.size();
+
 	uint32_t carry = 0;
-	bool overflow_possible = (x.getSign() == getSign());
+	bool overflow_possible = (x_sign == getSign());
 	
-	for(int i=0; i<data.size(); i++) {
-		uint32_t op2 = i < x.numWords() ? x.data[i] : (x.getSign() ? 0xFFFFFFFF : 0);
+	for(size_t i=0; i<data.size(); i++) {
+		uint32_t op2 = i < x_size ? x.data[i] : x_ext;
 		
 		data[i] += op2;
 		uint32_t carry_1 = data[i] < op2;
@@ -83,49 +98,76 @@ void bigInt::add (const bigInt &x, bool auto_upsize = true) {
 	}
 	
 	 
-	if(overflow_possible && (getSign() != x.getSign()) && auto_upsize) {
+	if(overflow_possible && (getSign() != x_sign) && auto_upsize) {
 		carry = carry ? 0xFFFFFFFF : 0;
 		data.push_back(carry);
 	}
 }
 
+// Borrows directly instead of adding a negated copy
 void bigInt::sub (const bigInt &x, bool auto_upsize = true) {
-	bigInt temp = x;
-	temp.signInvert();
-	add(temp,auto_upsize);
+
+	if(auto_upsize) {
+		size_t result_size = std::max(numWords(), x.numWords());
+	
+		if(data.size() < result_size)
+			data.resize(result_size,(getSign() ? 0xFFFFFFFF : 0));
+	}
+
+	bool sign = getSign(), x_sign = x.getSign();
+	uint32_t x_ext = x_sign ? 0xFFFFFFFF : 0;
+	size_t x_size = x.data.size();
+
+	uint32_t borrow = 0;
+	for(size_t i=0; i<data.size(); i++) {
+		uint32_t op2 = i < x_size ? x.data[i] : x_ext;
+		uint32_t d = data[i];
+
+		data[i] = d - op2 - borrow;
+		borrow = (d < op2) | ((d == op2) & borrow);
+	}
+
+	// Only operands of different sign can overflow, the result then has the subtrahend's sign
+	if((sign != x_sign) && (getSign() == x_sign) && auto_upsize)
+		data.push_back(sign ? 0xFFFFFFFF : 0);
 }
 
 // Old school multiplication - Time complexity O(size^2)
-// Output is sized to accomodate result
+// Output is sized to accomodate result, the product itself is done on 64 bit limbs
 bigInt bigInt::mul (const bigInt &x) const {
 	
-	bigInt xx = *this, yy = x;
+	// Negative operands are copied and inverted, positive ones are used as they are
+	bigInt neg_x, neg_y;
+	const bigInt *px = this, *py = &x;
 
 	bool invert_result = false;
 	
-	if(xx.getSign()) {
-		xx.signInvert();
-		invert_result = ~invert_result;
+	if(getSign()) {
+		neg_x = *this;
+		neg_x.signInvert();
+		px = &neg_x;
+		invert_result = !invert_result;
 	}
 	
-	if(yy.getSign()) {
-		yy.signInvert();
-		invert_result = ~invert_result;
+	if(x.getSign()) {
+		neg_y = x;
+		neg_y.signInvert();
+		py = &neg_y;
+		invert_result = !invert_result;
 	}
+	const bigInt &xx = *px, &yy = *py;
 	
-	bigInt res(xx.numWords() + yy.numWords()+1);
-	
-	for(int i=0; i<xx.numWords(); i++) {
-		uint32_t carry = 0;
-		for(int j=0; j<yy.numWords(); j++) {
-			uint64_t temp = (uint64_t) xx.data[i] * (uint64_t) yy.data[j];
-			temp += res.data[i+j];
-			temp += carry;
-			res.data[i+j] = temp;
-			carry = temp >> 32;
-		}
-		res.data[yy.numWords()+i] = carry;
-	}
+	int nx = xx.numWords(), ny = yy.numWords();
+	int lx = (nx+1)/2, ly = (ny+1)/2;
+	bigInt res(nx + ny + 1);
+
+	// Magnitudes go through the 64 bit limb kernels
+	limb_pool::vector<limb64::limb> limbs(lx + ly + lx + ly);
+	limb64::limb *a = limbs.data(), *b = a + lx, *prod = b + ly;
+	limb64::from32(a, xx.data.data(), nx);
+	limb64::from32(b, yy.data.data(), ny);
+	limb64::mul(prod, a, lx, b, ly);
+	limb64::to32(res.data.data(), prod, nx + ny);
 	
 	if(invert_result)
 		res.signInvert();
@@ -133,6 +175,28 @@ bigInt bigInt::mul (const bigInt &x) const {
 	return res;
 }
 
+// Squaring - the cross products are computed once and doubled
+bigInt bigInt::sqr () const {
+
+	bigInt neg;
+	if(getSign()) {
+		neg = *this;
+		neg.signInvert();
+	}
+	const bigInt &xx = getSign() ? neg : *this;
+
+	int nx = xx.numWords(), lx = (nx+1)/2;
+	bigInt res(2*nx + 1);
+
+	limb_pool::vector<limb64::limb> limbs(3*lx);
+	limb64::limb *a = limbs.data(), *prod = a + lx;
+	limb64::from32(a, xx.data.data(), nx);
+	limb64::sqr(prod, a, lx);
+	limb64::to32(res.data.data(), prod, 2*nx);
+
+	return res;
+}
+
 // Partial Multiplication - only num_words of output are calculated
 // Comes in handy for modular multiplication, i/o treated as unsigned numbers
 // Time complexity - O(num_words^2)
@@ -152,41 +216,180 @@ bigInt bigInt::mulPartial (const bigInt &x, int num_words) const {
 			res.data[i+j] = temp;
 			carry = temp >> 32;
 		}
+		if(i+numWords() < num_words)
+			res.data[i+numWords()] = carry;
 	}
 	return res;
 }
 
+/**********************************************************************
+
+	Windowed exponentiation, shared by bigInt and bigIntN
+
+	Sliding window scans the exponent from the top and multiplies by
+	an odd power x^1 .. x^(2^w - 1) once per window, zero bits in
+	between are only squared - about 1 + 1/(w+1) multiplies per bit.
+
+	Fixed window does w squarings and one multiply for every w bits
+	of the full exponent width, zero windows included, and reads the
+	whole x^0 .. x^(2^w - 1) table for each multiply. The sequence of
+	operations and memory accesses doesn't depend on the exponent.
+
+***********************************************************************/
+
+// OpenSSL's window sizes by exponent length
+int expmod_window_bits (int exp_bits) {
+	return exp_bits > 671 ? 6 : exp_bits > 239 ? 5 : exp_bits > 79 ? 4 : exp_bits > 23 ? 3 : 1;
+}
+
+template <typename Num>
+static int exp_window (const Num &exp, int top, int bottom, int num_bits) {
+	int val = 0;
+	for(int k=top; k>=bottom; k--)
+		val = (val << 1) | (k < num_bits && exp.getBit(k));
+	return val;
+}
+
+// all ones when e == idx, without a branch
+static uint32_t eq_mask (uint32_t e, uint32_t idx) {
+	return (uint32_t) 0 - (uint32_t) (((uint64_t) (e ^ idx) - 1) >> 63);
+}
+
+static void table_select (bigInt &out, const bigInt *table, int n, uint32_t idx) {
+	size_t size = 0;
+	for(int e=0; e<n; e++)
+		size = std::max(size, table[e].data.size());
+
+	out.data.assign(size, 0);
+	for(int e=0; e<n; e++) {
+		uint32_t mask = eq_mask(e, idx);
+		for(size_t j=0; j<table[e].data.size(); j++)
+			out.data[j] |= table[e].data[j] & mask;
+	}
+}
+
+template <int Bits>
+static void table_select (bigIntN<Bits> &out, const bigIntN<Bits> *table, int n, uint32_t idx) {
+	out = bigIntN<Bits>();
+	for(int e=0; e<n; e++) {
+		uint32_t mask = eq_mask(e, idx);
+		for(int j=0; j<bigIntN<Bits>::num_words; j++)
+			out.data[j] |= table[e].data[j] & mask;
+	}
+}
+
+// acc and x in Montgomery form, acc holds one on entry
+template <typename Num, typename Ctx>
+static void expmod_sliding (Ctx &mm, Num &acc, const Num &x, const Num &exp, int num_bits, int w, Num *table) {
+	Num x2;
+	mm.msqr(x2, x);
+	table[0] = x;
+	for(int i=1; i < (1 << (w-1)); i++)
+		mm.mmult(table[i], table[i-1], x2);
+
+	bool started = false;
+	int i = num_bits - 1;
+	while(i >= 0) {
+		if(!exp.getBit(i)) {
+			if(started)
+				mm.msqr(acc, acc);
+			i--;
+			continue;
+		}
+
+		int l = std::max(i-w+1, 0);
+		while(!exp.getBit(l))
+			l++;
+
+		int val = exp_window(exp, i, l, num_bits);
+		if(started) {
+			for(int k=l; k<=i; k++)
+				mm.msqr(acc, acc);
+			mm.mmult(acc, acc, table[val >> 1]);
+		} else {
+			acc = table[val >> 1];
+			started = true;
+		}
+		i = l - 1;
+	}
+}
+
+template <typename Num, typename Ctx>
+static void expmod_fixed (Ctx &mm, Num &acc, const Num &x, const Num &exp, int num_bits, int w, Num *table) {
+	int n = 1 << w;
+	table[0] = acc;
+	for(int i=1; i<n; i++)
+		mm.mmult(table[i], table[i-1], x);
+
+	int num_windows = (num_bits + w - 1) / w;
+	Num t;
+	for(int i=num_windows-1; i>=0; i--) {
+		uint32_t val = exp_window(exp, i*w + w - 1, i*w, num_bits);
+		table_select(t, table, n, val);
+
+		if(i == num_windows-1) {
+			acc = t;
+			continue;
+		}
+		for(int k=0; k<w; k++)
+			mm.msqr(acc, acc);
+		mm.mmult(acc, acc, t);
+	}
+}
+
 // Modular exponentiation using Montgomery multiplication
 // Old school multiplication is also supported 
-bigInt bigInt::expmod (const bigInt &exp, const bigInt &mod, bool useMont = true)  const {
+bigInt bigInt::expmod (const bigInt &exp, const bigInt &mod, bool useMont = true, expmod_mode mode, int window)  const {
 	
 	if (useMont == false) {
 		bigInt acc(1,1);
 		bigInt x(*this);
 		for(int i=0; i<exp.numBits(); i++) {
 			if(exp.getBit(i)) {
-				acc = acc*x;
+				acc *= x;
 				acc.mod(mod);
 			}
 			
-			x = x * x;
+			x = x.sqr();
 			x.mod(mod);
 		}
 		
 		return acc;
 	}
-	
-	montMult mm(mod);
+
+	// A context of its own, the shared cache is only used when a caller asks for it
+	montCtx ctx(mod);
+	return expmod(exp, ctx, mode, window);
+}
+
+// Montgomery path against a prebuilt context
+bigInt bigInt::expmod (const bigInt &exp, const montCtx &ctx, expmod_mode mode, int window) const {
+
+	montMult mm(ctx);
 	bigInt x (*this);
 	mm.zn2mont(x);
 	bigInt acc(1,1);
 	mm.zn2mont(acc);
-	
-	for(int i=0; i<exp.numBits(); i++) {
-		if(exp.getBit(i))
-			mm.mmult(acc, acc, x);
-		
-		mm.mmult(x,x,x);
+
+	int num_bits = exp.isZero() ? 0 : exp.numBits();
+	
+	if(mode == expmod_mode::sliding_window) {
+		int w = std::min(std::max(window ? window : expmod_window_bits(num_bits), 1), EXPMOD_MAX_SLIDING);
+		limb_pool::vector<bigInt> table(1 << (w-1));
+		expmod_sliding(mm, acc, x, exp, num_bits, w, table.data());
+	} else if(mode == expmod_mode::fixed_window) {
+		// Full storage width, the exponent's length isn't revealed either
+		int width = exp.data.size()*32;
+		int w = std::min(std::max(window ? window : expmod_window_bits(width), 1), EXPMOD_MAX_FIXED);
+		limb_pool::vector<bigInt> table(1 << w);
+		expmod_fixed(mm, acc, x, exp, width, w, table.data());
+	} else {
+		for(int i=0; i<num_bits; i++) {
+			if(exp.getBit(i))
+				mm.mmult(acc, acc, x);
+			
+			mm.msqr(x,x);
+		}
 	}
 	mm.mont2zn(acc);
 	return acc;
@@ -195,7 +398,7 @@ bigInt bigInt::expmod (const bigInt &exp, const bigInt &mod, bool useMont = true
 // Bitwise AND
 void bigInt::bitAnd (const bigInt &x) {
 	
-	for(int i=0; i<data.size(); i++) {
+	for(int i=0; i<(int) data.size(); i++) {
 		uint32_t op2 = i < x.numWords() ? x.data[i] : (x.getSign() ? 0xFFFFFFFF : 0);
 		
 		data[i] &= op2;
@@ -212,12 +415,17 @@ bool bigInt::getBit(int i) const {
 
 // Calc Two's complement (in place)
 void bigInt::signInvert () {
-	for(auto &i : data)
-		i = ~i;
-	
-	uint32_t temp[] = {1};
-	bigInt One(temp,1);
-	add(One);
+	bool sign = getSign();
+
+	uint32_t carry = 1;
+	for(auto &i : data) {
+		i = ~i + carry;
+		carry = carry && (i == 0);
+	}
+
+	// -(-2^(32n-1)) needs another word
+	if(!data.empty() && getSign() == sign && !isZero())
+		data.push_back(sign ? 0 : 0xFFFFFFFF);
 }
 
 // Right/Left shift
@@ -256,20 +464,38 @@ uint32_t bigInt::lsh(bool auto_upsize = false) {
 	return ov;
 }
 
-// Modulo reduction, time complexity O(size^3)
-void bigInt::mod (const bigInt &N) {
-	bigInt div = N;
-	while(!(*this < N)) {
-		uint32_t ov;
-		while(!(*this < div))
-			div.lsh(true);
-		
-		div.rsh();
-		sub(div);
-		div = N;
+// Long division (Knuth Algorithm D on 64 bit limbs), operands are positive - Time complexity O(size^2)
+// q and r get a word of headroom so they stay positive
+void bigInt::divmod (const bigInt &N, bigInt &q, bigInt &r) const {
+	int na = numWords(), nd = N.numWords();
+	if(nd == 0) {
+		std::cout << "Division by zero" << std::endl;
+		std::exit(1);
 	}
+
+	int la = (na+1)/2, ld = (nd+1)/2;
+	int lq = la < ld ? 1 : la-ld+1;
+
+	limb_pool::vector<limb64::limb> limbs(la + ld + lq + ld);
+	limb64::limb *a = limbs.data(), *d = a + la, *q64 = d + ld, *r64 = q64 + lq;
+	limb64::from32(a, data.data(), na);
+	limb64::from32(d, N.data.data(), nd);
+	limb64::divrem(q64, r64, a, la, d, ld);
+
+	q = bigInt(2*lq + 1);
+	r = bigInt(2*ld + 1);
+	limb64::to32(q.data.data(), q64, 2*lq);
+	limb64::to32(r.data.data(), r64, 2*ld);
+}
+
+// Modulo reduction through divmod
+void bigInt::mod (const bigInt &N) {
+	bigInt q, r;
+	divmod(N, q, r);
+	*this = std::move(r);
 	
-	data.resize(N.numWords());
+	// r < N fits in N's words, the extra one is the sign word and keeps it positive
+	data.resize(N.numWords() + 1);
 }
 
 // Returns sign - true = -ve , false = +ve
@@ -305,6 +531,22 @@ bigInt operator+ (const bigInt & op1, const bigInt & op2) {
 	return result;
 }
 
+// Temporaries are added into and moved out instead of copied
+bigInt operator+ (bigInt && op1, const bigInt & op2) {
+	op1.add(op2);
+	return std::move(op1);
+}
+
+bigInt operator+ (const bigInt & op1, bigInt && op2) {
+	op2.add(op1);
+	return std::move(op2);
+}
+
+bigInt operator+ (bigInt && op1, bigInt && op2) {
+	op1.add(op2);
+	return std::move(op1);
+}
+
 
 bigInt operator- (const bigInt & op1, const bigInt & op2) {
 	bigInt result = op1;
@@ -312,10 +554,36 @@ bigInt operator- (const bigInt & op1, const bigInt & op2) {
 	return result;
 }
 
+bigInt operator- (bigInt && op1, const bigInt & op2) {
+	op1.sub(op2);
+	return std::move(op1);
+}
+
+bigInt operator- (bigInt && op1, bigInt && op2) {
+	op1.sub(op2);
+	return std::move(op1);
+}
+
 bigInt operator* (const bigInt &x, const bigInt &y ) {
 	return x.mul(y);
 }
 
+bigInt &bigInt::operator+= (const bigInt &x) {
+	add(x);
+	return *this;
+}
+
+bigInt &bigInt::operator-= (const bigInt &x) {
+	sub(x);
+	return *this;
+}
+
+// The product needs its own buffer, it replaces ours without a copy
+bigInt &bigInt::operator*= (const bigInt &x) {
+	*this = mul(x);
+	return *this;
+}
+
 bool operator == (const bigInt & lhs, const bigInt & rhs) {
 	int rsize = rhs.data.size();
 	int lsize = lhs.data.size();
@@ -580,7 +848,7 @@ by transforming data into Montgomery domain where modulo is calculated over 2^n.
 Given: a,b, modulus M
 calc:	a*b mod M
 
-First we select, smallest R = 2^n : R > M
+First we select R = 2^(64n), n the number of 64 bit limbs in M
 Conversion into Mont domain is defined as a' = a*R mod M. So,
 
 a' = aR mod M
@@ -598,9 +866,9 @@ This division will be effecient if C had zeros in the LSB. To achive this we'll
 	C = C + M*t = 0 mod R (Note that C + Mt  = C mod M, C remains unchanged mod M)
 =>	t = -C/M mod R = C * -1/M mod R
 
-	-1/M mod R is pre calculated using Extende Euclidean algorithm and is called mprime.
+	Done one 64 bit limb at a time only -1/M mod 2^64 is needed, Newton's iteration gives it as mprime.
 	
-	So, t = c*mprime mod R
+	So, t = c*mprime mod 2^64, repeated for every limb
 	
 	Thus our reduction algorithm becomes - 
 	C = C + m*t, t=c*mprime mod R
@@ -609,6 +877,9 @@ This division will be effecient if C had zeros in the LSB. To achive this we'll
 	Now, that we have a effecient algo for Montgomery reduction (mred), we can define multiplication algo as - 
 	
 	MMult(a',b') = mred(a' * b')
+
+	mmult interleaves the two (CIOS) - one limb of b' is multiplied in and one limb reduced per step, so the
+	working value stays n+2 limbs. msqr keeps the separate form as the square only needs half the partial products.
 	
 	For entering into Montgomery domain, we need a' = a.R mod M = MMult(a,R^2) {R^2 mod M is pre calculated }
 	Similarly for leaving Montgomery domain, we need a = a'/R mod M = mred(a')
@@ -617,68 +888,376 @@ This division will be effecient if C had zeros in the LSB. To achive this we'll
 	as we have to enter and exit Montgomery domain only once.
 **************************************************************************************************************************/
 
-montMult::montMult(const bigInt &m) {
-	calcMontParams(m);
-}
-		
-void montMult::calcMontParams (const bigInt &m) {
-	
+montCtx::montCtx(const bigInt &m) : m (m) {
+
 	if(m.isEven()) {
 		std::cout << "Modulus cannot be even for montgomery multiplication" << std::endl;
 		std::exit(1);
 	}
-	
-	this->m = m;
-	
-	R.data.resize(m.numWords(),0);
-	R.data[m.numWords()-1] = 0x1;
-	
-	//R.lsh(m.numBits()-1);
-	while(R < m)
-		R.lsh(true);
-	
-	bigInt Rprime, g;
-	
-	g = binEGCD_i(R,m,Rprime,mprime);
-	mprime.signInvert();
-	
-	Rsquare = R*R;
-	Rsquare.mod(m);
-	bigInt one(1,1);
-	modRmask = R - one;
-	
+
+	int nw = m.numWords();
+	num_limbs = (nw+1)/2;
+	m64.assign(num_limbs, 0);
+	limb64::from32(m64.data(), m.data.data(), nw);
+	mprime = limb64::mont_inverse(m64[0]);
+
+	limb_pool::vector<limb64::limb> r2(num_limbs), t(num_limbs + 2);
+	limb64::mont_r2(r2.data(), m64.data(), num_limbs, mprime, t.data());
+	Rsquare = bigInt(2*num_limbs + 1);
+	limb64::to32(Rsquare.data.data(), r2.data(), 2*num_limbs);
+
 	#ifdef DEBUG_MONT
 	std::cout << "M = " << m << std::endl;
-	std::cout << "R = " << R << std::endl;
 	std::cout << "Mp= " << mprime << std::endl;
 	std::cout << "R2= " << Rsquare << std::endl;
 	#endif
-	
 }
 
-void montMult::mred ( bigInt &a) {
+namespace {
+	typedef std::pair<limb_pool::vector<uint32_t>, std::shared_ptr<const montCtx>> ctx_entry;
 
-	// t = a * mprime (mod R);
-	bigInt t = a.mulPartial(mprime,R.numWords());
-	t.bitAnd(modRmask);
-	
- 	a = a + (m * t);
-	a.rsh(R.numBits()-1);
-	
-	if(!(a < m))
-		a.sub(m);
+	// Most recently used first, the map points into the list
+	struct mont_ctx_cache {
+		std::mutex mtx;
+		size_t capacity = MONT_CTX_CACHE_SIZE;
+		std::list<ctx_entry> lru;
+		std::map<limb_pool::vector<uint32_t>, std::list<ctx_entry>::iterator> index;
+
+		void trim () {
+			while(lru.size() > capacity) {
+				index.erase(lru.back().first);
+				lru.pop_back();
+			}
+		}
+	};
+
+	mont_ctx_cache &ctx_cache () {
+		static mont_ctx_cache cache;
+		return cache;
+	}
+}
+
+// Contexts are built outside the lock, two threads missing on the same modulus both build and one is kept
+std::shared_ptr<const montCtx> montCtx::cached (const bigInt &m) {
+	limb_pool::vector<uint32_t> key(m.data.begin(), m.data.begin() + m.numWords());
+	mont_ctx_cache &c = ctx_cache();
+
+	{
+		std::lock_guard<std::mutex> lk(c.mtx);
+		auto it = c.index.find(key);
+		if(it != c.index.end()) {
+			c.lru.splice(c.lru.begin(), c.lru, it->second);
+			return it->second->second;
+		}
+	}
+
+	auto ctx = std::make_shared<const montCtx>(m);
+
+	std::lock_guard<std::mutex> lk(c.mtx);
+	if(c.capacity == 0)
+		return ctx;
+
+	auto it = c.index.find(key);
+	if(it != c.index.end())
+		return it->second->second;
+
+	c.lru.emplace_front(key, ctx);
+	c.index[key] = c.lru.begin();
+	c.trim();
+	return ctx;
+}
+
+void montCtx::set_cache_size (size_t n) {
+	mont_ctx_cache &c = ctx_cache();
+	std::lock_guard<std::mutex> lk(c.mtx);
+	c.capacity = n;
+	c.trim();
+}
+
+montMult::montMult(const bigInt &m) {
+	calcMontParams(m);
+}
+
+montMult::montMult(const montCtx &ctx) : ctx (&ctx) {
+	buf.assign(4*ctx.num_limbs + 2 + limb64::mul_n_scratch(ctx.num_limbs), 0);
+}
+		
+void montMult::calcMontParams (const bigInt &m) {
+	owned = std::make_shared<const montCtx>(m);
+	ctx = owned.get();
+
+	// a, b, a 2n+2 limb product / reduction buffer and the squaring scratch
+	buf.assign(4*ctx->num_limbs + 2 + limb64::mul_n_scratch(ctx->num_limbs), 0);
+}
+
+// Low 2n limbs of a into dst, zero padded
+void montMult::load (limb64::limb *dst, const bigInt &a, int n) {
+	int nw = std::min((int) a.data.size(), 2*n);
+	std::memset(dst, 0, n*sizeof(limb64::limb));
+	limb64::from32(dst, a.data.data(), nw);
+}
+
+void montMult::store (bigInt &c, const limb64::limb *src) {
+	c.data.assign(2*ctx->num_limbs + 1, 0);
+	limb64::to32(c.data.data(), src, 2*ctx->num_limbs);
+}
+
+// a < mR
+void montMult::mred ( bigInt &a) {
+	limb64::limb *t = buf.data() + 2*ctx->num_limbs;
+	load(t, a, 2*ctx->num_limbs + 1);
+	limb64::redc(buf.data(), t, ctx->m64.data(), ctx->num_limbs, ctx->mprime);
+	store(a, buf.data());
 }
 
 void montMult::mmult (bigInt &c, const bigInt &a, const bigInt &b) {
-	c = a*b;
-	mred(c);
+	INSTR_COUNT(INSTR_MONT_MULT, 1);
+	limb64::limb *a64 = buf.data(), *b64 = a64 + ctx->num_limbs, *t = b64 + ctx->num_limbs;
+	load(a64, a, ctx->num_limbs);
+	load(b64, b, ctx->num_limbs);
+	limb64::mont_mul(a64, a64, b64, ctx->m64.data(), ctx->num_limbs, ctx->mprime, t);
+	store(c, a64);
+}
 
+void montMult::msqr (bigInt &c, const bigInt &a) {
+	INSTR_COUNT(INSTR_MONT_SQR, 1);
+	limb64::limb *a64 = buf.data(), *t = a64 + 2*ctx->num_limbs;
+	load(a64, a, ctx->num_limbs);
+	limb64::sqr_n(t, a64, ctx->num_limbs, t + 2*ctx->num_limbs + 2);
+	t[2*ctx->num_limbs] = 0;
+	limb64::redc(a64, t, ctx->m64.data(), ctx->num_limbs, ctx->mprime);
+	store(c, a64);
 }
 
 void montMult::zn2mont (bigInt &a) {
-	mmult(a,a,Rsquare);
+	if(!(a < ctx->m))
+		a.mod(ctx->m);
+	mmult(a,a,ctx->Rsquare);
 }
 
 void montMult::mont2zn (bigInt &a) {
 	mred(a);
-}
\ No newline at end of file
+}
+
+/**************************************************************************************************************************
+
+	Fixed width bigIntN
+
+**************************************************************************************************************************/
+
+template <int Bits>
+bigIntN<Bits>::bigIntN() {
+	for(int i=0; i<num_words; i++)
+		data[i] = 0;
+}
+
+template <int Bits>
+bigIntN<Bits>::bigIntN(uint32_t val) : bigIntN() {
+	data[0] = val;
+}
+
+template <int Bits>
+bigIntN<Bits>::bigIntN(const bigInt &x) {
+	for(int i=0; i<num_words; i++)
+		data[i] = i < (int) x.data.size() ? x.data[i] : 0;
+}
+
+// One extra zero word keeps the signed bigInt positive
+template <int Bits>
+bigInt bigIntN<Bits>::toBigInt() const {
+	bigInt x(num_words+1);
+	for(int i=0; i<num_words; i++)
+		x.data[i] = data[i];
+	return x;
+}
+
+template <int Bits>
+int bigIntN<Bits>::numBits() const {
+	for(int i=num_words-1; i>=0; i--) {
+		if(data[i])
+			return i*32 + 32 - __builtin_clz(data[i]);
+	}
+	return 0;
+}
+
+template <int Bits>
+bool bigIntN<Bits>::getBit(int i) const {
+	return (data[i/32] >> (i%32)) & 0x1;
+}
+
+template <int Bits>
+bool bigIntN<Bits>::isZero() const {
+	uint32_t acc = 0;
+	for(int i=0; i<num_words; i++)
+		acc |= data[i];
+	return acc == 0;
+}
+
+template <int Bits>
+bool bigIntN<Bits>::isOdd() const {
+	return data[0] & 0x1;
+}
+
+template <int Bits>
+uint32_t bigIntN<Bits>::add(const bigIntN &x) {
+	uint64_t carry = 0;
+	for(int i=0; i<num_words; i++) {
+		carry += (uint64_t) data[i] + x.data[i];
+		data[i] = carry;
+		carry >>= 32;
+	}
+	return carry;
+}
+
+template <int Bits>
+uint32_t bigIntN<Bits>::sub(const bigIntN &x) {
+	uint64_t borrow = 0;
+	for(int i=0; i<num_words; i++) {
+		uint64_t temp = (uint64_t) data[i] - x.data[i] - borrow;
+		data[i] = temp;
+		borrow = (temp >> 32) & 0x1;
+	}
+	return borrow;
+}
+
+template <int Bits>
+uint32_t bigIntN<Bits>::lsh() {
+	uint32_t ov = 0;
+	for(int i=0; i<num_words; i++) {
+		uint32_t ov_nxt = data[i] >> 31;
+		data[i] = (data[i] << 1) | ov;
+		ov = ov_nxt;
+	}
+	return ov;
+}
+
+// Same square and multiply order as bigInt::expmod, every temporary is on the stack
+template <int Bits>
+bigIntN<Bits> bigIntN<Bits>::expmod(const bigIntN &exp, const bigIntN &mod, expmod_mode mode, int window) const {
+	return expmod(exp, montMultN<Bits>(mod), mode, window);
+}
+
+template <int Bits>
+bigIntN<Bits> bigIntN<Bits>::expmod(const bigIntN &exp, const montMultN<Bits> &mm, expmod_mode mode, int window) const {
+	bigIntN x(*this), acc(1);
+	mm.zn2mont(x);
+	mm.zn2mont(acc);
+
+	int num_bits = exp.isZero() ? 0 : exp.numBits();
+	bigIntN table[1 << EXPMOD_MAX_FIXED];
+
+	if(mode == expmod_mode::sliding_window) {
+		int w = std::min(std::max(window ? window : expmod_window_bits(num_bits), 1), EXPMOD_MAX_SLIDING);
+		expmod_sliding(mm, acc, x, exp, num_bits, w, table);
+	} else if(mode == expmod_mode::fixed_window) {
+		int w = std::min(std::max(window ? window : expmod_window_bits(Bits), 1), EXPMOD_MAX_FIXED);
+		expmod_fixed(mm, acc, x, exp, Bits, w, table);
+	} else {
+		for(int i=0; i<num_bits; i++) {
+			if(exp.getBit(i))
+				mm.mmult(acc, acc, x);
+
+			mm.msqr(x, x);
+		}
+	}
+	mm.mont2zn(acc);
+	return acc;
+}
+
+template <int Bits>
+bool operator == (const bigIntN<Bits> &lhs, const bigIntN<Bits> &rhs) {
+	uint32_t diff = 0;
+	for(int i=0; i<bigIntN<Bits>::num_words; i++)
+		diff |= lhs.data[i] ^ rhs.data[i];
+	return diff == 0;
+}
+
+template <int Bits>
+bool operator < (const bigIntN<Bits> &lhs, const bigIntN<Bits> &rhs) {
+	for(int i=bigIntN<Bits>::num_words-1; i>=0; i--) {
+		if(lhs.data[i] != rhs.data[i])
+			return lhs.data[i] < rhs.data[i];
+	}
+	return false;
+}
+
+/**************************************************************************************************************************
+
+	Fixed width Montgomery multiplication, R = 2^(64*num_limbs)
+
+	Operands are converted to 64 bit limbs and multiplied / reduced with the limb64 kernels. mprime = -1/m mod 2^64
+	comes from Newton's iteration. R^2 mod m is built by limb level doubling and a few Montgomery squares, so
+	setting up a context doesn't allocate either. A context is immutable and can be shared between threads.
+
+	mmult is the separated operand scanning form - the full product t = a*b first, then one limb of t is cleared per
+	step by adding u*m, u = t[i]*mprime, leaving t/R < 2m in the top half.
+
+**************************************************************************************************************************/
+
+template <int Bits>
+montMultN<Bits>::montMultN(const bigIntN<Bits> &m) : m (m) {
+	if(!m.isOdd()) {
+		std::cout << "Modulus cannot be even for montgomery multiplication" << std::endl;
+		std::exit(1);
+	}
+
+	limb64::from32(m64, m.data, bigIntN<Bits>::num_words);
+	mprime = limb64::mont_inverse(m64[0]);
+
+	limb64::limb r2[num_limbs], t[num_limbs + 2];
+	limb64::mont_r2(r2, m64, num_limbs, mprime, t);
+	limb64::to32(Rsquare.data, r2, bigIntN<Bits>::num_words);
+}
+
+template <int Bits>
+void montMultN<Bits>::mmult(bigIntN<Bits> &c, const bigIntN<Bits> &a, const bigIntN<Bits> &b) const {
+	INSTR_COUNT(INSTR_MONT_MULT, 1);
+	limb64::limb a64[num_limbs], b64[num_limbs], c64[num_limbs], t[2*num_limbs+1];
+	limb64::limb scratch[limb64::mul_n_scratch(num_limbs)];
+
+	limb64::from32(a64, a.data, bigIntN<Bits>::num_words);
+	limb64::from32(b64, b.data, bigIntN<Bits>::num_words);
+
+	limb64::mul_n(t, a64, b64, num_limbs, scratch);
+	t[2*num_limbs] = 0;
+	limb64::redc(c64, t, m64, num_limbs, mprime);
+
+	limb64::to32(c.data, c64, bigIntN<Bits>::num_words);
+}
+
+template <int Bits>
+void montMultN<Bits>::msqr(bigIntN<Bits> &c, const bigIntN<Bits> &a) const {
+	INSTR_COUNT(INSTR_MONT_SQR, 1);
+	limb64::limb a64[num_limbs], c64[num_limbs], t[2*num_limbs+1];
+	limb64::limb scratch[limb64::mul_n_scratch(num_limbs)];
+
+	limb64::from32(a64, a.data, bigIntN<Bits>::num_words);
+
+	limb64::sqr_n(t, a64, num_limbs, scratch);
+	t[2*num_limbs] = 0;
+	limb64::redc(c64, t, m64, num_limbs, mprime);
+
+	limb64::to32(c.data, c64, bigIntN<Bits>::num_words);
+}
+
+template <int Bits>
+void montMultN<Bits>::zn2mont(bigIntN<Bits> &a) const {
+	mmult(a, a, Rsquare);
+}
+
+template <int Bits>
+void montMultN<Bits>::mont2zn(bigIntN<Bits> &a) const {
+	mmult(a, a, bigIntN<Bits>(1));
+}
+
+#define INSTANTIATE_BIGINTN(Bits) \
+	template class bigIntN<Bits>; \
+	template class montMultN<Bits>; \
+	template bool operator == (const bigIntN<Bits> &, const bigIntN<Bits> &); \
+	template bool operator < (const bigIntN<Bits> &, const bigIntN<Bits> &);
+
+INSTANTIATE_BIGINTN(1024)
+INSTANTIATE_BIGINTN(2048)
+INSTANTIATE_BIGINTN(3072)
+INSTANTIATE_BIGINTN(4096)
+INSTANTIATE_BIGINTN(8192)
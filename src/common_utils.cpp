@@ -4,6 +4,12 @@
 #include <cstdint>
 
 #include  "common_utils.h"
+#include  "instrument.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CPU_X86
+#endif
 
 uint16_t gf2_8_math::ff_mult (uint16_t op1, uint16_t op2) {
 	uint16_t temp = 0;
@@ -86,6 +92,167 @@ uint16_t gf2_8_math::ff_mult_inv( uint16_t a) {
 uint16_t gf2_8_math::lshc(uint16_t x, int shift) {
 	return ((uint16_t) ((x) << (shift)) | ((x) >> (8 - (shift))) );
 }
+
+/****************************************************************
+	GF(2^8) buffer arithmetic
+
+	Multiplying by a constant c is linear over the bits of the
+	other operand, so c*x = c*(x & 0xf) ^ c*(x & 0xf0). Two 16
+	entry tables of those products fit in a register each and
+	PSHUFB looks up 16 (32 with AVX2) nibbles at once.
+****************************************************************/
+
+namespace {
+
+	struct gf_log_tables {
+		uint8_t log[256];
+		uint8_t exp[512];	// doubled so log a + log b needs no reduction
+
+		gf_log_tables () {
+			uint16_t x = 1;
+			for(int i=0; i<255; i++) {
+				exp[i] = exp[i+255] = x;
+				log[x] = i;
+				x = gf2_8_math::ff_mult(x, 0x03);
+			}
+			exp[510] = exp[511] = 0;
+			log[0] = 0;
+		}
+	};
+
+	const gf_log_tables gf_tbl;
+
+	typedef void (*gf_buf_fn) (uint8_t *, const uint8_t *, uint8_t, size_t, bool);
+
+	void mul_row (uint8_t *row, uint8_t c) {
+		row[0] = 0;
+		for(int i=1; i<256; i++)
+			row[i] = c ? gf_tbl.exp[gf_tbl.log[c] + gf_tbl.log[i]] : 0;
+	}
+
+	void buf_scalar (uint8_t *dst, const uint8_t *src, uint8_t c, size_t n, bool acc) {
+		uint8_t row[256];
+		mul_row(row, c);
+
+		if (acc) {
+			for(size_t i=0; i<n; i++)
+				dst[i] ^= row[src[i]];
+		} else {
+			for(size_t i=0; i<n; i++)
+				dst[i] = row[src[i]];
+		}
+	}
+
+	void nibble_tables (uint8_t *lo, uint8_t *hi, uint8_t c) {
+		for(int i=0; i<16; i++) {
+			lo[i] = gf2_8_math::mul(c, i);
+			hi[i] = gf2_8_math::mul(c, i << 4);
+		}
+	}
+
+#ifdef CPU_X86
+	__attribute__((target("ssse3")))
+	void buf_ssse3 (uint8_t *dst, const uint8_t *src, uint8_t c, size_t n, bool acc) {
+		uint8_t lo[16], hi[16];
+		nibble_tables(lo, hi, c);
+
+		__m128i tlo  = _mm_loadu_si128((const __m128i *) lo);
+		__m128i thi  = _mm_loadu_si128((const __m128i *) hi);
+		__m128i mask = _mm_set1_epi8(0x0f);
+
+		size_t i = 0;
+		for(; i+16<=n; i+=16) {
+			__m128i x = _mm_loadu_si128((const __m128i *) (src+i));
+			__m128i p = _mm_xor_si128(
+				_mm_shuffle_epi8(tlo, _mm_and_si128(x, mask)),
+				_mm_shuffle_epi8(thi, _mm_and_si128(_mm_srli_epi64(x, 4), mask)));
+			if (acc)
+				p = _mm_xor_si128(p, _mm_loadu_si128((const __m128i *) (dst+i)));
+			_mm_storeu_si128((__m128i *) (dst+i), p);
+		}
+
+		for(; i<n; i++) {
+			uint8_t p = lo[src[i] & 0xf] ^ hi[src[i] >> 4];
+			dst[i] = acc ? dst[i] ^ p : p;
+		}
+	}
+
+	__attribute__((target("avx2")))
+	void buf_avx2 (uint8_t *dst, const uint8_t *src, uint8_t c, size_t n, bool acc) {
+		uint8_t lo[16], hi[16];
+		nibble_tables(lo, hi, c);
+
+		__m256i tlo  = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) lo));
+		__m256i thi  = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) hi));
+		__m256i mask = _mm256_set1_epi8(0x0f);
+
+		size_t i = 0;
+		for(; i+32<=n; i+=32) {
+			__m256i x = _mm256_loadu_si256((const __m256i *) (src+i));
+			__m256i p = _mm256_xor_si256(
+				_mm256_shuffle_epi8(tlo, _mm256_and_si256(x, mask)),
+				_mm256_shuffle_epi8(thi, _mm256_and_si256(_mm256_srli_epi64(x, 4), mask)));
+			if (acc)
+				p = _mm256_xor_si256(p, _mm256_loadu_si256((const __m256i *) (dst+i)));
+			_mm256_storeu_si256((__m256i *) (dst+i), p);
+		}
+
+		for(; i<n; i++) {
+			uint8_t p = lo[src[i] & 0xf] ^ hi[src[i] >> 4];
+			dst[i] = acc ? dst[i] ^ p : p;
+		}
+	}
+#endif
+
+	struct gf_buf_dispatch {
+		gf_buf_fn 	fn 		= buf_scalar;
+		const char 	*name 	= "scalar";
+
+		gf_buf_dispatch () {
+#ifdef CPU_X86
+			__builtin_cpu_init();
+			if (__builtin_cpu_supports("avx2")) {
+				fn = buf_avx2;
+				name = "avx2";
+			} else if (__builtin_cpu_supports("ssse3")) {
+				fn = buf_ssse3;
+				name = "ssse3";
+			}
+#endif
+		}
+	};
+
+	const gf_buf_dispatch gf_buf;
+}
+
+uint8_t gf2_8_math::mul (uint8_t a, uint8_t b) {
+	if (a == 0 || b == 0)
+		return 0;
+	return gf_tbl.exp[gf_tbl.log[a] + gf_tbl.log[b]];
+}
+
+uint8_t gf2_8_math::inv (uint8_t a) {
+	if (a == 0)
+		return 0;
+	return gf_tbl.exp[255 - gf_tbl.log[a]];
+}
+
+void gf2_8_math::mul_buf (uint8_t *dst, const uint8_t *src, uint8_t c, size_t n) {
+	gf_buf.fn(dst, src, c, n, false);
+}
+
+void gf2_8_math::mul_acc_buf (uint8_t *dst, const uint8_t *src, uint8_t c, size_t n) {
+	gf_buf.fn(dst, src, c, n, true);
+}
+
+void gf2_8_math::mul_acc_buf_scalar (uint8_t *dst, const uint8_t *src, uint8_t c, size_t n) {
+	buf_scalar(dst, src, c, n, true);
+}
+
+const char *gf2_8_math::buf_impl () {
+	return gf_buf.name;
+}
+
 void gf2_128_math::xor_acc (uint8_t *dst, const uint8_t *src) {
 	for(int i=0;i<16;i++)
 		dst[i] ^= src[i] ;
@@ -103,6 +270,7 @@ uint8_t gf2_128_math::rsh (uint8_t *a) {
 }
 
 void gf2_128_math::mult_gmac (uint8_t *res, const uint8_t *a, const uint8_t *b) {
+	INSTR_TIMED(INSTR_MULT_GMAC, 1);
 	uint8_t v[16];
 	uint8_t z[16];
 
@@ -125,6 +293,252 @@ void gf2_128_math::mult_gmac (uint8_t *res, const uint8_t *a, const uint8_t *b)
 	std::memcpy(res,z,16);
 }
 
+// res = h^n, square and multiply
+// Multiplicative identity in GCM bit order is 1 || 0^127
+void gf2_128_math::pow_gmac (uint8_t *res, const uint8_t *h, uint64_t n) {
+	uint8_t acc[16], sq[16];
+
+	std::memset(acc,0,16);
+	acc[0] = 0x80;
+	std::memcpy(sq,h,16);
+
+	while (n) {
+		if (n & 1)
+			mult_gmac(acc,acc,sq);
+		mult_gmac(sq,sq,sq);
+		n >>= 1;
+	}
+
+	std::memcpy(res,acc,16);
+}
+
+// Precompute i*H for all 4 bit i, as 2 64 bit halves in GCM bit order
+void gf2_128_math::ghash_init (ghash_key &key, const uint8_t *h) {
+	uint64_t vh = 0, vl = 0;
+	for(int i=0;i<8;i++) {
+		vh = (vh << 8) | h[i];
+		vl = (vl << 8) | h[i+8];
+	}
+
+	key.hh[0] = 0;
+	key.hl[0] = 0;
+	key.hh[8] = vh;
+	key.hl[8] = vl;
+
+	// 4, 2, 1 are H shifted right (multiplied by x) once, twice and thrice
+	for(int i=4;i>0;i>>=1) {
+		uint64_t t = (vl & 1) ? 0xE100000000000000ULL : 0;
+		vl = (vh << 63) | (vl >> 1);
+		vh = (vh >> 1) ^ t;
+		key.hh[i] = vh;
+		key.hl[i] = vl;
+	}
+
+	// Rest are XORs of the above
+	for(int i=2;i<=8;i*=2) {
+		for(int j=1;j<i;j++) {
+			key.hh[i+j] = key.hh[i] ^ key.hh[j];
+			key.hl[i+j] = key.hl[i] ^ key.hl[j];
+		}
+	}
+}
+
+// x = x * H, consumes x a nibble at a time from the last byte
+void gf2_128_math::ghash_mult (uint8_t *x, const ghash_key &key) {
+	INSTR_TIMED(INSTR_GHASH_MULT, 1);
+	// Reduction of the 4 bits shifted out, pre multiplied by the char polynomial
+	static const uint64_t last4[16] = {
+		0x0000, 0x1c20, 0x3840, 0x2460, 0x7080, 0x6ca0, 0x48c0, 0x54e0,
+		0xe100, 0xfd20, 0xd940, 0xc560, 0x9180, 0x8da0, 0xa9c0, 0xb5e0
+	};
+
+	uint8_t lo = x[15] & 0xf;
+	uint64_t zh = key.hh[lo], zl = key.hl[lo];
+
+	for(int i=15;i>=0;i--) {
+		uint8_t hi = x[i] >> 4;
+		lo = x[i] & 0xf;
+
+		if (i != 15) {
+			uint8_t rem = zl & 0xf;
+			zl = (zh << 60) | (zl >> 4);
+			zh = (zh >> 4) ^ (last4[rem] << 48);
+			zh ^= key.hh[lo];
+			zl ^= key.hl[lo];
+		}
+
+		uint8_t rem = zl & 0xf;
+		zl = (zh << 60) | (zl >> 4);
+		zh = (zh >> 4) ^ (last4[rem] << 48);
+		zh ^= key.hh[hi];
+		zl ^= key.hl[hi];
+	}
+
+	for(int i=0;i<8;i++) {
+		x[i]   = uint8_t (zh >> (56-8*i));
+		x[i+8] = uint8_t (zl >> (56-8*i));
+	}
+}
+
+// Folds data into GHASH accumulator, last partial block is zero padded
+void gf2_128_math::ghash (uint8_t *acc, const ghash_key &key, const uint8_t *data, int num_bytes) {
+	int num_full_blocks 	= num_bytes/16;
+	int num_partial_bytes 	= num_bytes%16;
+
+	for(int i=0; i<num_full_blocks; i++) {
+		xor_acc(acc,data+i*16);
+		ghash_mult(acc,key);
+	}
+
+	if (num_partial_bytes > 0) {
+		uint8_t temp[16];
+		std::memcpy(temp,data+num_full_blocks*16,num_partial_bytes);
+		std::memset(temp+num_partial_bytes,0,16-num_partial_bytes);
+		xor_acc(acc,temp);
+		ghash_mult(acc,key);
+	}
+}
+
+/****************************************************************
+	Hex codec
+
+	Encode splits 16 bytes into nibbles and maps them to digits
+	with one PSHUFB each. Decode range checks 16 chars against
+	'0'-'9' and 'a'-'f' (after folding case), maps them to their
+	values and PMADDUBSW folds each pair into hi*16 + lo.
+****************************************************************/
+
+namespace {
+
+	const char hex_digits[] = "0123456789abcdef";
+
+	struct hex_tables {
+		uint8_t val[256];	// 0xff - not a hex char
+
+		hex_tables () {
+			std::memset(val, 0xff, sizeof(val));
+			for(int i=0; i<16; i++) {
+				val[uint8_t (hex_digits[i])] = i;
+				if (i >= 10)
+					val[uint8_t (hex_digits[i] - 'a' + 'A')] = i;
+			}
+		}
+	};
+
+	const hex_tables hex_tbl;
+
+	typedef size_t (*hex_encode_fn) (char *, const uint8_t *, size_t);
+	typedef size_t (*hex_decode_fn) (uint8_t *, const char *, size_t, bool &);
+
+	// SIMD kernels do whole 16 byte blocks and return how many bytes they did
+	size_t hex_encode_none (char *, const uint8_t *, size_t) {
+		return 0;
+	}
+
+	size_t hex_decode_none (uint8_t *, const char *, size_t, bool &) {
+		return 0;
+	}
+
+#ifdef CPU_X86
+	__attribute__((target("ssse3")))
+	size_t hex_encode_ssse3 (char *out, const uint8_t *in, size_t n) {
+		__m128i digits = _mm_loadu_si128((const __m128i *) hex_digits);
+		__m128i mask = _mm_set1_epi8(0x0f);
+
+		size_t i = 0;
+		for(; i+16<=n; i+=16) {
+			__m128i x  = _mm_loadu_si128((const __m128i *) (in+i));
+			__m128i hi = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi64(x, 4), mask));
+			__m128i lo = _mm_shuffle_epi8(digits, _mm_and_si128(x, mask));
+
+			_mm_storeu_si128((__m128i *) (out+2*i), _mm_unpacklo_epi8(hi, lo));
+			_mm_storeu_si128((__m128i *) (out+2*i+16), _mm_unpackhi_epi8(hi, lo));
+		}
+		return i;
+	}
+
+	__attribute__((target("ssse3")))
+	inline __m128i hex_values (__m128i c, __m128i &bad) {
+		__m128i lc = _mm_or_si128(c, _mm_set1_epi8(0x20));
+
+		__m128i is_digit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0'-1)), _mm_cmplt_epi8(c, _mm_set1_epi8('9'+1)));
+		__m128i is_alpha = _mm_and_si128(_mm_cmpgt_epi8(lc, _mm_set1_epi8('a'-1)), _mm_cmplt_epi8(lc, _mm_set1_epi8('f'+1)));
+
+		bad = _mm_or_si128(bad, _mm_andnot_si128(_mm_or_si128(is_digit, is_alpha), _mm_set1_epi8(-1)));
+
+		return _mm_or_si128(
+			_mm_and_si128(is_digit, _mm_sub_epi8(c, _mm_set1_epi8('0'))),
+			_mm_and_si128(is_alpha, _mm_sub_epi8(lc, _mm_set1_epi8('a'-10))));
+	}
+
+	__attribute__((target("ssse3")))
+	size_t hex_decode_ssse3 (uint8_t *out, const char *in, size_t n, bool &ok) {
+		__m128i weights = _mm_set1_epi16(0x0110);	// hi*16 + lo per pair
+		__m128i bad = _mm_setzero_si128();
+
+		size_t i = 0;
+		for(; i+16<=n; i+=16) {
+			__m128i v0 = hex_values(_mm_loadu_si128((const __m128i *) (in+2*i)), bad);
+			__m128i v1 = hex_values(_mm_loadu_si128((const __m128i *) (in+2*i+16)), bad);
+
+			__m128i bytes = _mm_packus_epi16(_mm_maddubs_epi16(v0, weights), _mm_maddubs_epi16(v1, weights));
+			_mm_storeu_si128((__m128i *) (out+i), bytes);
+		}
+
+		ok = _mm_movemask_epi8(bad) == 0;
+		return i;
+	}
+#endif
+
+	struct hex_dispatch {
+		hex_encode_fn encode = hex_encode_none;
+		hex_decode_fn decode = hex_decode_none;
+
+		hex_dispatch () {
+#ifdef CPU_X86
+			__builtin_cpu_init();
+			if (__builtin_cpu_supports("ssse3")) {
+				encode = hex_encode_ssse3;
+				decode = hex_decode_ssse3;
+			}
+#endif
+		}
+	};
+
+	const hex_dispatch hex_simd;
+}
+
+void hex_encode (char *out, const uint8_t *in, size_t n) {
+	for(size_t i = hex_simd.encode(out, in, n); i<n; i++) {
+		out[2*i] 	= hex_digits[in[i] >> 4];
+		out[2*i+1] 	= hex_digits[in[i] & 0xf];
+	}
+}
+
+std::string hex_encode (const uint8_t *in, size_t n) {
+	std::string str(2*n, '\0');
+	hex_encode(&str[0], in, n);
+	return str;
+}
+
+bool hex_decode (uint8_t *out, std::string_view hex) {
+	if (hex.size() % 2)
+		return false;
+
+	size_t n = hex.size()/2;
+	bool ok = true;
+	uint8_t bad = 0;
+
+	for(size_t i = hex_simd.decode(out, hex.data(), n, ok); i<n; i++) {
+		uint8_t hi = hex_tbl.val[uint8_t (hex[2*i])];
+		uint8_t lo = hex_tbl.val[uint8_t (hex[2*i+1])];
+		bad |= (hi | lo) & 0xf0;
+		out[i] = (hi << 4) | lo;
+	}
+
+	return ok && !bad;
+}
+
 uint8_t char2hex (char ch) {
 	uint8_t nibble = ch;
 	if (nibble >= '0' && nibble <= '9')
@@ -137,43 +551,28 @@ uint8_t char2hex (char ch) {
 	return nibble;
 }
 
-void ascii2hex (uint8_t *buf, const char *ascii) {
-	std::string ascii_str = ascii;
-	int numbytes = 0;
-	for(std::string::iterator i=ascii_str.begin();i<ascii_str.end();i++) {
-		buf[numbytes] = char2hex(*i) << 4;
-		i++;
-		buf[numbytes] |= char2hex(*i);
-		numbytes++;
-	}
+bool ascii2hex (uint8_t *buf, const char *ascii) {
+	return hex_decode(buf, std::string_view(ascii));
 }
-void ascii2hex (uint8_t *buf, std::string ascii_str) {
 
-	int numbytes = 0;
-	for(std::string::iterator i=ascii_str.begin();i<ascii_str.end();i++) {
-		buf[numbytes] = char2hex(*i) << 4;
-		i++;
-		buf[numbytes] |= char2hex(*i);
-		numbytes++;
-	}
+bool ascii2hex (uint8_t *buf, std::string_view ascii_str) {
+	return hex_decode(buf, ascii_str);
 }
 
-void x_bytes (uint8_t *a, int size) {
-	
-	for(int i=0;i<size;i++)
-		std::cout << std::hex << std::setfill('0') << std::setw(2) << (short) a[i] << " ";
-	std::cout << std::endl;
+void x_bytes (const uint8_t *a, int size) {
+	std::string hex = hex_encode(a, size);
+	std::string line(3*size+1, ' ');
+	for(int i=0;i<size;i++) {
+		line[3*i] 	= hex[2*i];
+		line[3*i+1] = hex[2*i+1];
+	}
+	line[3*size] = '\n';
+	std::cout << line << std::flush;
 }
 
 uint8_t hexval (char n) {
-	uint8_t val;
-	if(n >= 'A' && n <= 'Z')
-		val = n - 'A' + 10;
-	else if (n >= 'a' && n <= 'z')
-		val = n - 'a'+ 10;
-	else if(n >= '0' && n <= '9')
-		val = n - '0';
-	else {
+	uint8_t val = hex_tbl.val[uint8_t (n)];
+	if (val == 0xff) {
 		std::cout << "Invalid hex char" << std::endl;
 		std::exit(1);
 	}
@@ -181,12 +580,12 @@ uint8_t hexval (char n) {
 	return val;
 }
 
-std::vector<uint8_t> str2vec(const char *str) {
-	std::size_t len = strlen(str);
-	std::vector<uint8_t> vec;
-	vec.reserve(len/2);
-	for(std::size_t i=0; i < len; i+=2) 
-		vec.push_back((hexval(str[i]) << 4) | hexval(str[i+1]));
+std::vector<uint8_t> str2vec (std::string_view str) {
+	std::vector<uint8_t> vec(str.size()/2);
+	if (!hex_decode(vec.data(), str)) {
+		std::cout << "Invalid hex string" << std::endl;
+		std::exit(1);
+	}
 
 	return vec;
-}
\ No newline at end of file
+}
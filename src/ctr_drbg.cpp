@@ -0,0 +1,147 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <random>
+
+#include "ctr_drbg.h"
+
+// V += n over the full 128 bits, same as the aes_ctr counter
+static void add_v (uint8_t *v, uint64_t n) {
+	for(int k=15; k>=0 && n; k--) {
+		n += v[k];
+		v[k] = uint8_t (n);
+		n >>= 8;
+	}
+}
+
+ctr_drbg::ctr_drbg () : cipher (AES256) {
+	uint8_t entropy[CTR_DRBG_SEED_BYTES];
+	os_entropy(entropy);
+	instantiate(entropy, nullptr);
+	auto_reseed = true;
+}
+
+ctr_drbg::ctr_drbg (const uint8_t *entropy, const uint8_t *pers) : cipher (AES256) {
+	instantiate(entropy, pers);
+	auto_reseed = false;
+}
+
+ctr_drbg &ctr_drbg::local () {
+	thread_local ctr_drbg drbg;
+	return drbg;
+}
+
+void ctr_drbg::os_entropy (uint8_t *out) {
+	std::random_device rd;
+	for(int i=0; i<CTR_DRBG_SEED_BYTES; i+=4) {
+		uint32_t r = rd();
+		std::memcpy(out+i, &r, 4);
+	}
+}
+
+void ctr_drbg::instantiate (const uint8_t *entropy, const uint8_t *pers) {
+	std::memset(key, 0, sizeof(key));
+	std::memset(v, 0, sizeof(v));
+	cipher.init_keys(key);
+
+	uint8_t seed[CTR_DRBG_SEED_BYTES];
+	for(int i=0; i<CTR_DRBG_SEED_BYTES; i++)
+		seed[i] = entropy[i] ^ (pers ? pers[i] : 0);
+
+	update(seed);
+	reseed_counter = 1;
+	buf_pos = CTR_DRBG_BUFFER_BYTES;
+}
+
+void ctr_drbg::reseed (const uint8_t *entropy, const uint8_t *add) {
+	uint8_t seed[CTR_DRBG_SEED_BYTES];
+	for(int i=0; i<CTR_DRBG_SEED_BYTES; i++)
+		seed[i] = entropy[i] ^ (add ? add[i] : 0);
+
+	update(seed);
+	reseed_counter = 1;
+	buf_pos = CTR_DRBG_BUFFER_BYTES;
+}
+
+// provided is CTR_DRBG_SEED_BYTES or nullptr for all zeros
+void ctr_drbg::update (const uint8_t *provided) {
+	uint8_t temp[CTR_DRBG_SEED_BYTES] = {0}, cntr[16];
+
+	std::memcpy(cntr, v, 16);
+	add_v(cntr, 1);
+	cipher.encrypt(temp, temp, cntr, CTR_DRBG_SEED_BYTES/16);
+
+	if (provided) {
+		for(int i=0; i<CTR_DRBG_SEED_BYTES; i++)
+			temp[i] ^= provided[i];
+	}
+
+	std::memcpy(key, temp, 32);
+	std::memcpy(v, temp+32, 16);
+	cipher.init_keys(key);
+}
+
+void ctr_drbg::generate (uint8_t *out, int num_bytes, const uint8_t *add) {
+	if (num_bytes < 0 || num_bytes > CTR_DRBG_MAX_REQUEST) {
+		std::cout << "Invalid CTR_DRBG request size " << num_bytes << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+
+	if (reseed_counter > CTR_DRBG_RESEED_INTERVAL) {
+		if (!auto_reseed) {
+			std::cout << "CTR_DRBG needs a reseed" << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+		uint8_t entropy[CTR_DRBG_SEED_BYTES];
+		os_entropy(entropy);
+		reseed(entropy);
+	}
+
+	if (add)
+		update(add);
+
+	uint8_t cntr[16];
+	std::memcpy(cntr, v, 16);
+	add_v(cntr, 1);
+
+	// Whole blocks straight into out, encrypted in place
+	int num_blocks = num_bytes / 16;
+	std::memset(out, 0, num_blocks*16);
+	cipher.encrypt(out, out, cntr, num_blocks);
+	add_v(cntr, num_blocks);
+
+	if (num_bytes % 16) {
+		uint8_t last[16] = {0};
+		cipher.encrypt(last, last, cntr, 1);
+		std::memcpy(out+num_blocks*16, last, num_bytes % 16);
+		num_blocks++;
+	}
+
+	add_v(v, num_blocks);
+	update(add);
+	reseed_counter++;
+}
+
+void ctr_drbg::fill (uint8_t *out, size_t num_bytes) {
+	while (num_bytes) {
+		if (buf_pos == CTR_DRBG_BUFFER_BYTES) {
+			generate(buf, CTR_DRBG_BUFFER_BYTES);
+			buf_pos = 0;
+		}
+
+		size_t n = std::min(num_bytes, size_t (CTR_DRBG_BUFFER_BYTES - buf_pos));
+		std::memcpy(out, buf+buf_pos, n);
+
+		// Served bytes are wiped so a later state compromise can't recover them
+		std::memset(buf+buf_pos, 0, n);
+		buf_pos += n;
+		out += n;
+		num_bytes -= n;
+	}
+}
+
+uint32_t ctr_drbg::next_u32 () {
+	uint32_t r;
+	fill(reinterpret_cast<uint8_t *>(&r), sizeof(r));
+	return r;
+}
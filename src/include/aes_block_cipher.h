@@ -1,10 +1,41 @@
 #ifndef _AES_BLOCK_CIPHER_H
-#define AES_BLOCK_CIPHER_H
+#define _AES_BLOCK_CIPHER_H
+
+#include "thread_pool.h"
+#include "common_utils.h"
 
 #define AES128 128
 #define AES192 192
 #define AES256 256
 
+#define GCM_BATCH_LANES 4
+
+#define OCB_BATCH_BLOCKS 8
+#define OCB_NUM_L 32
+
+#define CMAC_LANES 8
+
+#define AES_MAX_BLOCKS 8
+
+/****************************************************************
+	Block cipher backend
+
+	Modes below are templates over the block cipher backend, a
+	backend provides -
+		backend (int key_size);
+		void init_keys 		(const uint8_t *key_bytes);	// key schedule
+		void encrypt_block 	(const uint8_t *pt, uint8_t *ct);
+		void decrypt_block 	(uint8_t *pt, const uint8_t *ct);
+		void encrypt_blocks (const uint8_t *pt, uint8_t *ct, int num_blocks);
+		void decrypt_blocks (uint8_t *pt, const uint8_t *ct, int num_blocks);
+	Multi block calls take independent blocks (up to AES_MAX_BLOCKS
+	at a time from the modes) so a pipelined backend can keep
+	several in flight. Modes are instantiated for each backend at
+	the end of aes_block_cipher.cpp.
+
+	aes_block_cipher is the default (reference) backend.
+****************************************************************/
+
 class aes_block_cipher {
 	
 	private:	
@@ -43,63 +74,227 @@ class aes_block_cipher {
 	public:
 		aes_block_cipher (int key_sz);
 		
-		void init_keys(uint8_t *key_bytes);
+		void init_keys(const uint8_t *key_bytes);
 		void encrypt_block (const uint8_t *pt, uint8_t *ct);
 		void decrypt_block (uint8_t *pt, const uint8_t *ct);
+		void encrypt_blocks (const uint8_t *pt, uint8_t *ct, int num_blocks);
+		void decrypt_blocks (uint8_t *pt, const uint8_t *ct, int num_blocks);
 };
 
-class aes_ecb : public aes_block_cipher {
+template <class block_cipher>
+class ecb_mode : public block_cipher {
 	
 	public:
-		aes_ecb (int key_size);	
+		ecb_mode (int key_size);	
 		void encrypt (const uint8_t *pt, uint8_t *ct, int num_blocks);
 		void decrypt (uint8_t *pt, const uint8_t *ct, int num_blocks);
 
 };
 
-class aes_cbc : public aes_block_cipher {
+template <class block_cipher>
+class cbc_mode : public block_cipher {
 	
 	public:
-		aes_cbc (int key_size);	
+		cbc_mode (int key_size);	
 		void encrypt (const uint8_t *pt, uint8_t *ct, const uint8_t *iv, int num_blocks);
 		void decrypt (uint8_t *pt, const uint8_t *ct, const uint8_t *iv, int num_blocks);
 
 };
 
-class aes_cfb : public aes_block_cipher {
+template <class block_cipher>
+class cfb_mode : public block_cipher {
 	
 	public:
-		aes_cfb (int key_size);	
+		cfb_mode (int key_size);	
 		void encrypt (const uint8_t *pt, uint8_t *ct, const uint8_t *iv, int num_blocks);
 		void decrypt (uint8_t *pt, const uint8_t *ct, const uint8_t *iv, int num_blocks);
 
 };
 
-class aes_ofb : public aes_block_cipher {
+template <class block_cipher>
+class ofb_mode : public block_cipher {
 	
 	public:
-		aes_ofb (int key_size);	
+		ofb_mode (int key_size);	
 		void encrypt (const uint8_t *pt, uint8_t *ct, const uint8_t *iv, int num_blocks);
 		void decrypt (uint8_t *pt, const uint8_t *ct, const uint8_t *iv, int num_blocks);
 
 };
 
-class aes_ctr : public aes_block_cipher {
+template <class block_cipher>
+class ctr_mode : public block_cipher {
 	
 	public:
-		aes_ctr (int key_size);	
+		ctr_mode (int key_size);	
 		void encrypt (const uint8_t *pt, uint8_t *ct, const uint8_t *iv, int num_blocks);
 		void decrypt (uint8_t *pt, const uint8_t *ct, const uint8_t *iv, int num_blocks);
 
 };
 
-class aes_gcm : public aes_block_cipher {
+// Per packet descriptor for the GCM batch API
+// encryptandsign_batch 	- reads pt, writes ct and tag
+// decryptandverify_batch 	- reads ct and tag, writes pt and is_valid (pt is zeroed if not valid)
+struct gcm_packet {
+	const uint8_t 	*iv;
+	const uint8_t 	*aad;
+	uint8_t 		*pt;
+	uint8_t 		*ct;
+	uint8_t 		*tag;
+	int 			num_aad_bytes;
+	int 			num_pt_bytes;
+	bool 			is_valid;
+};
+
+template <class block_cipher>
+class gcm_mode : public block_cipher {
 	
+	private:
+		void process_lanes (gcm_packet *pkts, int num_lanes, bool is_encrypt);
+
+	protected:
+		// H = E(0) and its GHASH table, derived in init_keys
+		uint8_t 					h[16];
+		gf2_128_math::ghash_key 	h_tbl;
+
+		void finish_tag (uint8_t *tag, const uint8_t *cntr0_enc, uint64_t num_aad_bytes, uint64_t num_pt_bytes);
+		void ctr_xor 	(uint8_t *dst, const uint8_t *src, uint8_t *cntr, int num_bytes);
+
 	public:
-		aes_gcm (int key_size);	
+		gcm_mode (int key_size);	
+		void init_keys(const uint8_t *key_bytes);
 		void incr_cntr(uint8_t *cntr);
+		void add_cntr(uint8_t *cntr, uint32_t n);
 		void encryptandsign   (const uint8_t *pt, const uint8_t *aad, const uint8_t *iv, uint8_t *ct, uint8_t *tag, int num_aad_blocks, int num_pt_blocks);
 		bool decryptandverify (uint8_t *pt, const uint8_t *aad, const uint8_t *iv, const uint8_t *ct, const uint8_t *tag,  int num_aad_blocks, int num_pt_blocks);
 
+		// Many independent packets under the same key
+		void encryptandsign_batch   (gcm_packet *pkts, int num_pkts);
+		bool decryptandverify_batch (gcm_packet *pkts, int num_pkts);
+
+};
+
+// GMAC - GCM with no plaintext, authenticates aad only using the per key GHASH table
+// One shot sign/verify, or incremental init/update/final for streams
+template <class block_cipher>
+class gmac_mode : public gcm_mode<block_cipher> {
+
+	public:
+		gmac_mode (int key_size);
+		void sign   (const uint8_t *aad, const uint8_t *iv, uint8_t *tag, int num_aad_bytes);
+		bool verify (const uint8_t *aad, const uint8_t *iv, const uint8_t *tag, int num_aad_bytes);
+
+		void init   (const uint8_t *iv);
+		void update (const uint8_t *aad, int num_aad_bytes);
+		void final  (uint8_t *tag);
+
+	private:
+		uint8_t 	acc[16], buf[16], cntr0_enc[16];
+		int 		num_buf_bytes = 0;
+		uint64_t 	num_total_bytes = 0;
+};
+
+// OCB3 (RFC 7253) - one pass AEAD, every block is an independent cipher call
+// whitened by an offset built from precomputed L values, blocks are processed
+// OCB_BATCH_BLOCKS at a time. Nonce is 1 to 15 bytes, tag 1 to 16 bytes.
+template <class block_cipher>
+class ocb_mode : public block_cipher {
+
+	public:
+		ocb_mode (int key_size, int tag_bytes = 16, int nonce_bytes = 12);
+		void init_keys(const uint8_t *key_bytes);
+		void encryptandsign   (const uint8_t *pt, const uint8_t *aad, const uint8_t *nonce, uint8_t *ct, uint8_t *tag, int num_aad_bytes, int num_pt_bytes);
+		bool decryptandverify (uint8_t *pt, const uint8_t *aad, const uint8_t *nonce, const uint8_t *ct, const uint8_t *tag,  int num_aad_bytes, int num_pt_bytes);
+
+	private:
+		int 		tag_bytes, nonce_bytes;
+		uint8_t 	l_star[16], l_dollar[16], l[OCB_NUM_L][16];
+
+		void init_offset (uint8_t *offset, const uint8_t *nonce);
+		void hash 		 (uint8_t *sum, const uint8_t *aad, int num_aad_bytes);
+		void calc_tag 	 (uint8_t *tag, uint8_t *checksum, const uint8_t *offset, const uint8_t *aad, int num_aad_bytes);
 };
+
+// CCM (RFC 3610, SP 800-38C) - CBC-MAC and CTR done in a single pass, the CTR keystream
+// block of each step is independent of the serial MAC chain and is ciphered next to it.
+// Nonce is 7 to 13 bytes, tag is 4 to 16 bytes (even).
+template <class block_cipher>
+class ccm_mode : public block_cipher {
+
+	public:
+		ccm_mode (int key_size, int tag_bytes = 16, int nonce_bytes = 12);
+		void encryptandsign   (const uint8_t *pt, const uint8_t *aad, const uint8_t *nonce, uint8_t *ct, uint8_t *tag, int num_aad_bytes, int num_pt_bytes);
+		bool decryptandverify (uint8_t *pt, const uint8_t *aad, const uint8_t *nonce, const uint8_t *ct, const uint8_t *tag,  int num_aad_bytes, int num_pt_bytes);
+
+	private:
+		int 		tag_bytes, nonce_bytes;
+
+		void init_mac  (uint8_t *mac, uint8_t *cntr, uint8_t *cntr0_enc, const uint8_t *nonce, const uint8_t *aad, int num_aad_bytes, int num_pt_bytes);
+		void incr_cntr (uint8_t *cntr);
+};
+
+// Per message descriptor for the CMAC batch API
+struct cmac_msg {
+	const uint8_t 	*msg;
+	uint8_t 		*tag;
+	int 			num_bytes;
+};
+
+// CMAC (RFC 4493) - one shot, incremental, and a batch API that advances up to
+// CMAC_LANES independent CBC-MAC chains in lockstep
+template <class block_cipher>
+class cmac_mode : public block_cipher {
+
+	public:
+		cmac_mode (int key_size);
+		void init_keys(const uint8_t *key_bytes);
+
+		void sign   (const uint8_t *msg, uint8_t *tag, int num_bytes);
+		bool verify (const uint8_t *msg, const uint8_t *tag, int num_bytes);
+
+		void init   ();
+		void update (const uint8_t *msg, int num_bytes);
+		void final  (uint8_t *tag);
+
+		void sign_batch (cmac_msg *msgs, int num_msgs);
+
+	private:
+		uint8_t 	k1[16], k2[16];
+		uint8_t 	mac[16], buf[16];
+		int 		num_buf_bytes = 0;
+
+		void last_block (uint8_t *blk, const uint8_t *msg, int num_bytes);
+};
+
+// GCM for large messages - ciphertext is split into chunks, each chunk does CTR + partial
+// GHASH on a pool thread and partial hashes are stitched together with powers of H.
+// Produces exactly the same output as aes_gcm, small messages take the serial path.
+template <class block_cipher>
+class gcm_mt_mode : public gcm_mode<block_cipher> {
+
+	public:
+		gcm_mt_mode (int key_size, int num_threads = 0, int chunk_bytes = 64*1024);
+		void encryptandsign   (const uint8_t *pt, const uint8_t *aad, const uint8_t *iv, uint8_t *ct, uint8_t *tag, int num_aad_bytes, int num_pt_bytes);
+		bool decryptandverify (uint8_t *pt, const uint8_t *aad, const uint8_t *iv, const uint8_t *ct, const uint8_t *tag,  int num_aad_bytes, int num_pt_bytes);
+
+	private:
+		thread_pool pool;
+		int 		chunk_bytes;
+
+		void chunk_pass 	(uint8_t *dst, const uint8_t *src, const uint8_t *cntr1, uint8_t *partials, int num_bytes);
+		void fold_partials 	(uint8_t *tag, const uint8_t *partials, int num_bytes);
+};
+
+// Modes over the default backend
+typedef ecb_mode<aes_block_cipher> 		aes_ecb;
+typedef cbc_mode<aes_block_cipher> 		aes_cbc;
+typedef cfb_mode<aes_block_cipher> 		aes_cfb;
+typedef ofb_mode<aes_block_cipher> 		aes_ofb;
+typedef ctr_mode<aes_block_cipher> 		aes_ctr;
+typedef gcm_mode<aes_block_cipher> 		aes_gcm;
+typedef gmac_mode<aes_block_cipher> 	aes_gmac;
+typedef ocb_mode<aes_block_cipher> 		aes_ocb;
+typedef ccm_mode<aes_block_cipher> 		aes_ccm;
+typedef cmac_mode<aes_block_cipher> 	aes_cmac;
+typedef gcm_mt_mode<aes_block_cipher> 	aes_gcm_mt;
+
 #endif
\ No newline at end of file
@@ -0,0 +1,70 @@
+#ifndef _AES_GCM_STREAM_H
+#define _AES_GCM_STREAM_H
+
+#include <cstdint>
+
+#include "aes_block_cipher.h"
+#include "thread_pool.h"
+
+/****************************************************************
+	Segmented AEAD container over AES GCM
+
+	header (32 bytes)
+		magic "LCGS" | version (1) | 3 zero bytes |
+		chunk_bytes (u32 BE) | pt_bytes (u64 BE) |
+		nonce prefix (7) | 5 zero bytes
+	chunk 0 .. n-1
+		ct (chunk_bytes, last chunk may be shorter) | tag (16)
+
+	Chunk i is sealed with
+		iv  = nonce prefix | i (u32 BE) | final flag (0 or 1)
+		aad = header | i (u64 BE)
+	so chunks can't be reordered, dropped, truncated or moved to
+	another container, and every chunk verifies on its own.
+	An empty message is one empty final chunk.
+****************************************************************/
+
+#define GCM_STREAM_HEADER_BYTES 	32
+#define GCM_STREAM_PREFIX_BYTES 	7
+#define GCM_STREAM_TAG_BYTES 		16
+
+struct gcm_stream_header {
+	uint32_t 	chunk_bytes;
+	uint64_t 	pt_bytes;
+	uint8_t 	nonce_prefix[GCM_STREAM_PREFIX_BYTES];
+
+	uint64_t num_chunks () const;
+	int 	 chunk_pt_bytes (uint64_t chunk) const;
+	uint64_t chunk_offset (uint64_t chunk) const;	// from start of the container
+	uint64_t sealed_bytes () const;
+
+	void write (uint8_t *out) const;
+	bool read  (const uint8_t *in);		// false if not a valid header
+};
+
+// Chunks are sealed and opened in parallel on a thread pool
+class aes_gcm_stream : public aes_gcm {
+
+	public:
+		aes_gcm_stream (int key_size, int chunk_bytes = 64*1024, int num_threads = 0);
+
+		uint64_t sealed_bytes (uint64_t pt_bytes) const;
+
+		// nonce_prefix must be unique per container under a key, out is sealed_bytes(pt_bytes) long
+		void seal (const uint8_t *pt, uint64_t pt_bytes, const uint8_t *nonce_prefix, uint8_t *out);
+
+		// Whole container, pt gets header.pt_bytes bytes (zeroed if anything fails to verify)
+		bool open (uint8_t *pt, const uint8_t *in, uint64_t in_bytes);
+
+		// Chunks [first_chunk, first_chunk+num_chunks) only, hdr is the raw container header
+		// and in points to the first requested chunk. pt gets the plaintext of those chunks.
+		bool open_chunks (uint8_t *pt, const uint8_t *hdr, const uint8_t *in, uint64_t first_chunk, uint64_t num_chunks);
+
+	private:
+		thread_pool pool;
+		int 		chunk_bytes;
+
+		void chunk_iv_aad (uint8_t *iv, uint8_t *aad, const gcm_stream_header &h, uint64_t chunk);
+};
+
+#endif
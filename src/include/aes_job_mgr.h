@@ -0,0 +1,94 @@
+#ifndef _AES_JOB_MGR_H
+#define _AES_JOB_MGR_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "aes_block_cipher.h"
+
+enum aes_job_type {
+	AES_JOB_ECB_ENC,
+	AES_JOB_ECB_DEC,
+	AES_JOB_CBC_ENC,
+	AES_JOB_CBC_DEC,
+	AES_JOB_CTR,
+	AES_JOB_GCM_SEAL,
+	AES_JOB_GCM_OPEN
+};
+
+// Expanded key shared by all jobs submitted under it
+struct aes_job_key {
+	aes_job_key (int key_size, const uint8_t *key_bytes);
+
+	aes_block_cipher 	cipher;		// ECB, CBC and CTR
+	aes_gcm 			gcm;
+};
+
+// One request, buffers have to stay valid until the job completes
+// ECB/CBC	- num_bytes is a multiple of 16, iv is 16 bytes (CBC)
+// CTR		- iv is the 16 byte initial counter
+// GCM		- iv is 12 bytes, seal writes tag, open reads tag
+struct aes_job {
+	aes_job_type 		type;
+	const aes_job_key 	*key;
+	const uint8_t 		*iv;
+	const uint8_t 		*aad;
+	const uint8_t 		*src;
+	uint8_t 			*dst;
+	uint8_t 			*tag;
+	int 				num_aad_bytes;
+	int 				num_bytes;
+};
+
+// Asynchronous job queue - jobs submitted from any thread are collected and
+// flushed as a batch when batch_jobs are pending or the oldest pending job has
+// waited max_latency_us. Jobs of a batch are grouped by key and type, and each
+// group is run as one multi block call (or the GCM batch API) so small jobs
+// from many callers share the cipher pipeline.
+// Result is true on success, false for a bad GCM tag or an invalid job.
+class aes_job_mgr {
+
+	public:
+		aes_job_mgr (int batch_jobs = 32, int max_latency_us = 100);
+		~aes_job_mgr ();	// completes pending jobs
+
+		std::future<bool> submit (const aes_job &job);
+		void submit (const aes_job &job, std::function<void(bool)> done);
+
+	private:
+		typedef std::chrono::steady_clock clock;
+
+		struct pending_job {
+			aes_job 					job;
+			std::promise<bool> 			result;
+			std::function<void(bool)> 	done;
+			clock::time_point 			t_submit;
+		};
+
+		int 						batch_jobs;
+		clock::duration 			max_latency;
+
+		std::deque<pending_job> 	queue;
+		std::mutex 					mtx;
+		std::condition_variable 	cv;
+		bool 						stop = false;
+		std::thread 				dispatcher;
+
+		void enqueue 		(pending_job &&p);
+		void dispatch_loop 	();
+		void run_batch 		(std::vector<pending_job> &batch);
+
+		void run_ecb (std::vector<pending_job *> &jobs, bool *res);
+		void run_cbc (std::vector<pending_job *> &jobs, bool *res);
+		void run_ctr (std::vector<pending_job *> &jobs, bool *res);
+		void run_gcm (std::vector<pending_job *> &jobs, bool *res);
+};
+
+#endif
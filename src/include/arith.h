@@ -1,3 +1,6 @@
+#ifndef _ARITH_H
+#define _ARITH_H
+
 #include <cstdint>
 #include <cstring>
 #include <iostream>
@@ -5,16 +8,41 @@
 #include <cstdlib>
 #include <iomanip>
 #include <vector>
+#include <memory>
+
+#include "limb64.h"
+#include "limb_pool.h"
+
+// Exponent scan of the Montgomery expmod paths
+enum class expmod_mode {
+	binary,				// bit by bit, right to left
+	sliding_window,		// odd power table, for public exponents
+	fixed_window		// same square / multiply sequence for every exponent and a masked table read,
+						// for secret exponents. Not constant time: the REDC carry ripple and the
+						// Karatsuba / Toom-3 sign handling still branch on operand values
+};
+
+#define EXPMOD_MAX_SLIDING 	6
+#define EXPMOD_MAX_FIXED 	5
+
+int expmod_window_bits (int exp_bits);
+
+class montCtx;
+template <int Bits> class montMultN;
 
 class bigInt {
 
 public :
-	std::vector<uint32_t> data;
+	limb_pool::vector<uint32_t> data;
 
 	bigInt();
 	bigInt(int);
 	bigInt(int, int);
 	bigInt(uint32_t [], int );
+	bigInt(const bigInt &) = default;
+	bigInt(bigInt &&) = default;
+	bigInt &operator= (const bigInt &) = default;
+	bigInt &operator= (bigInt &&) = default;
 	~bigInt();
 	
 	void randInit();
@@ -27,39 +55,137 @@ public :
 	void signInvert ();
 	void sub(const bigInt &, bool);
 	bigInt mul(const bigInt &) const;
+	bigInt sqr() const;
 	bigInt mulPartial(const bigInt &, int num_words) const;
-	bigInt expmod(const bigInt &exp, const bigInt &mod, bool) const;
+	// window = 0 picks the width from the exponent size
+	bigInt expmod(const bigInt &exp, const bigInt &mod, bool,
+				  expmod_mode mode = expmod_mode::fixed_window, int window = 0) const;
+	bigInt expmod(const bigInt &exp, const montCtx &ctx,
+				  expmod_mode mode = expmod_mode::fixed_window, int window = 0) const;
 	void bitAnd(const bigInt &);
 	void rsh (int);
 	uint32_t lsh(bool);
 	bool getBit(int i) const;
 
 	void mod (const bigInt &);
+	void divmod (const bigInt &, bigInt &q, bigInt &r) const;
 	bool isOdd () const;
 	bool isEven () const;
+
+	bigInt &operator+= (const bigInt &);
+	bigInt &operator-= (const bigInt &);
+	bigInt &operator*= (const bigInt &);
 	
 	
 };
 
 std::ostream& operator<<(std::ostream& , const bigInt &);
 bigInt operator+ (const bigInt &, const bigInt &);
+bigInt operator+ (bigInt &&, const bigInt &);
+bigInt operator+ (const bigInt &, bigInt &&);
+bigInt operator+ (bigInt &&, bigInt &&);
 bigInt operator- (const bigInt &, const bigInt &);
+bigInt operator- (bigInt &&, const bigInt &);
+bigInt operator- (bigInt &&, bigInt &&);
 bigInt operator* (const bigInt &, const bigInt &);
 bool operator == (const bigInt &, const bigInt &);
 bool operator < (const bigInt &, const bigInt &);
 bool operator > (const bigInt &, const bigInt &);
 	
+#define MONT_CTX_CACHE_SIZE 	16
+
+// Per modulus Montgomery parameters, immutable once built so one context can be shared between threads
+class montCtx {
+	public :
+		explicit montCtx(const bigInt &m);
+
+		// Opt in LRU cache keyed by modulus, a size of 0 turns it off. Cached moduli stay
+		// in memory until evicted, pass secret ones to expmod through a local context
+		static std::shared_ptr<const montCtx> cached(const bigInt &m);
+		static void set_cache_size(size_t n);
+
+		bigInt m, Rsquare;
+		int num_limbs;
+		limb_pool::vector<limb64::limb> m64;
+		limb64::limb mprime;	// -1/m mod 2^64
+};
+
+// Montgomery multiplication over a context, the scratch buffer makes each instance single threaded
 class montMult {
 	public :
-		montMult(const bigInt &m);
+		montMult(const bigInt &m);			// builds its own context
+		montMult(const montCtx &ctx);		// prebuilt context, has to outlive this
 		void calcMontParams(const bigInt &m);
 		void mmult(bigInt &c, const bigInt &a, const bigInt &b);
+		void msqr(bigInt &c, const bigInt &a);
 		void mred (bigInt &a);
 		void zn2mont(bigInt &a);
 		void mont2zn(bigInt &a);
 		
 	private:
-		bigInt m, R, Rsquare, mprime, modRmask;
+		void load (limb64::limb *dst, const bigInt &a, int n);
+		void store (bigInt &c, const limb64::limb *src);
+
+		std::shared_ptr<const montCtx> owned;
+		const montCtx *ctx;
+		limb_pool::vector<limb64::limb> buf;
+};
+
+bigInt binEGCD_i (bigInt a, bigInt b, bigInt & x, bigInt & y);
+
+/**********************************************************************
+
+	Fixed width unsigned integers - limbs live inline, all loops run
+	to compile time bounds and nothing touches the heap. Instantiated
+	for 1024, 2048, 3072, 4096 and 8192 bits in arith.cpp.
+
+***********************************************************************/
+
+template <int Bits>
+class bigIntN {
+	static_assert(Bits % 32 == 0, "bigIntN width must be a multiple of 32 bits");
+
+public :
+	static const int num_words = Bits / 32;
+	uint32_t data[num_words];
+
+	bigIntN();
+	bigIntN(uint32_t);
+	bigIntN(const bigInt &);	// low Bits of a non negative bigInt
+	bigInt toBigInt() const;
+
+	int numBits() const;
+	bool getBit(int i) const;
+	bool isZero() const;
+	bool isOdd() const;
+	uint32_t add(const bigIntN &);	// returns carry out
+	uint32_t sub(const bigIntN &);	// returns borrow out
+	uint32_t lsh();					// by one bit, returns bit shifted out
+	bigIntN expmod(const bigIntN &exp, const bigIntN &mod,
+				   expmod_mode mode = expmod_mode::fixed_window, int window = 0) const;
+	bigIntN expmod(const bigIntN &exp, const montMultN<Bits> &mm,
+				   expmod_mode mode = expmod_mode::fixed_window, int window = 0) const;
+};
+
+template <int Bits> bool operator == (const bigIntN<Bits> &, const bigIntN<Bits> &);
+template <int Bits> bool operator < (const bigIntN<Bits> &, const bigIntN<Bits> &);
+
+// Montgomery multiplication on 64 bit limbs, R = 2^(64*num_limbs)
+template <int Bits>
+class montMultN {
+	public :
+		static const int num_limbs = (bigIntN<Bits>::num_words + 1) / 2;
+
+		explicit montMultN(const bigIntN<Bits> &m);
+		void mmult(bigIntN<Bits> &c, const bigIntN<Bits> &a, const bigIntN<Bits> &b) const;
+		void msqr(bigIntN<Bits> &c, const bigIntN<Bits> &a) const;
+		void zn2mont(bigIntN<Bits> &a) const;
+		void mont2zn(bigIntN<Bits> &a) const;
+
+	private:
+		bigIntN<Bits> m, Rsquare;
+		limb64::limb m64[num_limbs];
+		limb64::limb mprime;	// -1/m mod 2^64
 };
 
-bigInt binEGCD_i (bigInt a, bigInt b, bigInt & x, bigInt & y);
\ No newline at end of file
+#endif
\ No newline at end of file
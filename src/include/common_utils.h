@@ -1,6 +1,10 @@
 #ifndef _COMMON_UTILS_H
 #define _COMMON_UTILS_H
 
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
 #include <vector>
 
 namespace gf2_8_math {
@@ -15,20 +19,48 @@ namespace gf2_8_math {
 	uint16_t ff_mult_inv( uint16_t a);
 	uint16_t lshc(uint16_t x, int shift);
 
+	// Table based scalar ops (log/antilog, generator 0x03)
+	uint8_t mul (uint8_t a, uint8_t b);
+	uint8_t inv (uint8_t a);
+
+	// Buffer kernels - dst = c*src and dst ^= c*src over n bytes, dst may equal src
+	// PSHUFB nibble tables (SSSE3/AVX2) when the CPU has them, scalar otherwise
+	void mul_buf (uint8_t *dst, const uint8_t *src, uint8_t c, size_t n);
+	void mul_acc_buf (uint8_t *dst, const uint8_t *src, uint8_t c, size_t n);
+	void mul_acc_buf_scalar (uint8_t *dst, const uint8_t *src, uint8_t c, size_t n);
+	const char *buf_impl ();
+
 }
 
 namespace gf2_128_math {
 	void xor_acc (uint8_t *dst, const uint8_t *src);
 	uint8_t rsh (uint8_t *a);
 	void mult_gmac (uint8_t *res, const uint8_t *a, const uint8_t *b);
+	void pow_gmac (uint8_t *res, const uint8_t *h, uint64_t n);
+
+	// Per key table of the 16 multiples of H by a 4 bit value (Shoup's method),
+	// lets GHASH multiply by H a nibble at a time instead of a bit at a time
+	struct ghash_key {
+		uint64_t hh[16], hl[16];
+	};
+	void ghash_init (ghash_key &key, const uint8_t *h);
+	void ghash_mult (uint8_t *x, const ghash_key &key);
+	void ghash (uint8_t *acc, const ghash_key &key, const uint8_t *data, int num_bytes);
 }
 
+// Hex codec (SSSE3 when the CPU has it) - encode writes 2*n lower case chars,
+// decode takes an even number of [0-9a-fA-F] and writes hex.size()/2 bytes.
+// decode returns false on bad input, out is unspecified then.
+void hex_encode (char *out, const uint8_t *in, size_t n);
+std::string hex_encode (const uint8_t *in, size_t n);
+bool hex_decode (uint8_t *out, std::string_view hex);
+
 uint8_t char2hex (char ch); 
-void ascii2hex (uint8_t *buf,const char * ascii);
-void ascii2hex (uint8_t *buf, std::string ascii_str);
-void x_bytes (uint8_t *a, int size);
+bool ascii2hex (uint8_t *buf, const char *ascii);
+bool ascii2hex (uint8_t *buf, std::string_view ascii_str);
+void x_bytes (const uint8_t *a, int size);
 
 uint8_t hexval(char);
-std::vector<uint8_t> str2vec (const char *);
+std::vector<uint8_t> str2vec (std::string_view);
 
 #endif
@@ -0,0 +1,55 @@
+#ifndef _CTR_DRBG_H
+#define _CTR_DRBG_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "aes_block_cipher.h"
+
+/****************************************************************
+	CTR_DRBG (SP 800-90A) - AES-256, no derivation function
+
+	State is a 256 bit key and a 128 bit counter V. Output is
+	the aes_ctr keystream from V+1, after every request the
+	state is replaced by three more keystream blocks (update).
+
+	fill() and next_u32() serve from a buffer refilled one
+	generate request at a time, local() returns a per thread
+	instance seeded from std::random_device so callers never
+	share state or take locks.
+****************************************************************/
+
+#define CTR_DRBG_SEED_BYTES 		48
+#define CTR_DRBG_MAX_REQUEST 		(1 << 16)	// bytes per generate, 2^19 bits
+#define CTR_DRBG_BUFFER_BYTES 		4096
+#define CTR_DRBG_RESEED_INTERVAL 	(1 << 20)	// requests
+
+class ctr_drbg {
+
+	public:
+		ctr_drbg ();	// seeded from std::random_device
+		ctr_drbg (const uint8_t *entropy, const uint8_t *pers = nullptr);	// CTR_DRBG_SEED_BYTES each
+
+		void reseed (const uint8_t *entropy, const uint8_t *add = nullptr);
+		void generate (uint8_t *out, int num_bytes, const uint8_t *add = nullptr);
+
+		void fill (uint8_t *out, size_t num_bytes);
+		uint32_t next_u32 ();
+
+		static ctr_drbg &local ();
+
+	private:
+		aes_ctr 	cipher;
+		uint8_t 	key[32], v[16];
+		uint64_t 	reseed_counter;
+		bool 		auto_reseed;
+
+		uint8_t 	buf[CTR_DRBG_BUFFER_BYTES];
+		int 		buf_pos;
+
+		void instantiate (const uint8_t *entropy, const uint8_t *pers);
+		void update (const uint8_t *provided);
+		void os_entropy (uint8_t *out);
+};
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef _INSTRUMENT_H
+#define _INSTRUMENT_H
+
+#include <cstdint>
+
+/****************************************************************
+	Hot path instrumentation
+
+	Built in with -DLAZY_CRYPTO_INSTRUMENT=ON (LC_INSTRUMENT),
+	rdtsc latency histograms additionally with
+	-DLAZY_CRYPTO_INSTRUMENT_CYCLES=ON (LC_INSTRUMENT_CYCLES).
+	Without them INSTR_COUNT / INSTR_TIMED expand to nothing.
+
+	Counters are per thread and only written by their owner,
+	snapshot() sums all live and exited threads. reset() moves
+	the baseline snapshots are taken against, so it doesn't
+	race with threads that are counting.
+****************************************************************/
+
+enum instr_op {
+	INSTR_ENCRYPT_BLOCK,
+	INSTR_DECRYPT_BLOCK,
+	INSTR_KEY_SCHEDULE,
+	INSTR_MULT_GMAC,
+	INSTR_GHASH_MULT,
+	INSTR_INCR_CNTR,
+	INSTR_MONT_MULT,
+	INSTR_MONT_SQR,
+	INSTR_NUM_OPS
+};
+
+#define INSTR_HIST_BUCKETS 	32		// bucket i - [2^i, 2^(i+1)) cycles
+
+struct instr_counter {
+	uint64_t calls;
+	uint64_t units;		// blocks, multiplies or increments done by those calls
+	uint64_t cycles;
+	uint64_t hist[INSTR_HIST_BUCKETS];
+};
+
+struct instr_snapshot {
+	instr_counter ops[INSTR_NUM_OPS];
+};
+
+namespace instrument {
+	bool enabled ();
+	bool cycles_enabled ();
+	const char *op_name (instr_op op);
+
+	instr_snapshot snapshot ();
+	void reset ();
+
+	void count (instr_op op, uint64_t units);
+	void record (instr_op op, uint64_t units, uint64_t cycles);
+	uint64_t cycle_count ();
+
+	// Records the cycles from construction to destruction
+	class scoped_timer {
+		public:
+			scoped_timer (instr_op op, uint64_t units) : op (op), units (units), start (cycle_count()) {}
+			~scoped_timer () { record(op, units, cycle_count() - start); }
+
+		private:
+			instr_op op;
+			uint64_t units, start;
+	};
+}
+
+#ifdef LC_INSTRUMENT
+#define INSTR_COUNT(op, n) 	instrument::count(op, n)
+#ifdef LC_INSTRUMENT_CYCLES
+#define INSTR_TIMED(op, n) 	instrument::scoped_timer instr_timer_(op, n)
+#else
+#define INSTR_TIMED(op, n) 	instrument::count(op, n)
+#endif
+#else
+#define INSTR_COUNT(op, n) 	do {} while (0)
+#define INSTR_TIMED(op, n) 	do {} while (0)
+#endif
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef _LIMB64_H
+#define _LIMB64_H
+
+#include <cstdint>
+
+/**********************************************************************
+
+	64 bit limb kernels for the multi precision code
+
+	Limbs are little endian (limb 0 is least significant) and all
+	numbers are unsigned. Products and carries go through unsigned
+	__int128, the row kernel additionally has a MULX/ADCX/ADOX
+	version picked at runtime when the CPU has BMI2 and ADX. Large
+	products switch to Karatsuba and Toom-3.
+
+	from32/to32 convert to and from bigInt's 32 bit data layout,
+	an odd number of 32 bit words is zero padded.
+
+***********************************************************************/
+
+namespace limb64 {
+
+	typedef uint64_t limb;
+
+	limb add_n (limb *r, const limb *a, const limb *b, int n);		// r = a + b, returns carry
+	limb sub_n (limb *r, const limb *a, const limb *b, int n);		// r = a - b, returns borrow
+	limb addmul_1 (limb *r, const limb *a, int n, limb b);		// r += a*b, returns the carry limb
+	void mul (limb *r, const limb *a, int na, const limb *b, int nb);	// r has na+nb limbs
+
+	// Balanced product with caller provided scratch, Karatsuba / Toom-3 above the thresholds
+	constexpr int mul_n_scratch (int n) { return 8*n; }
+	void mul_n (limb *r, const limb *a, const limb *b, int n, limb *scratch);
+	void set_mul_thresholds (int karatsuba, int toom3);		// in limbs, for tuning
+
+	// a*a with each cross product computed once, r has 2n limbs
+	void sqr (limb *r, const limb *a, int n);
+	void sqr_n (limb *r, const limb *a, int n, limb *scratch);
+
+	// q = a / d (na-nd+1 limbs), r = a mod d (nd limbs), d[nd-1] != 0
+	void divrem (limb *q, limb *r, const limb *a, int na, const limb *d, int nd);
+
+	// Montgomery reduction, R = 2^(64n). t has 2n+1 limbs holding a value < mR and
+	// is used as scratch, r gets t/R mod m (< m). mprime is -1/m mod 2^64.
+	void redc (limb *r, limb *t, const limb *m, int n, limb mprime);
+
+	// Montgomery multiplication r = a*b/R mod m with interleaved reduction (CIOS), a, b < m.
+	// t is n+2 limbs of scratch, r may alias a or b
+	void mont_mul (limb *r, const limb *a, const limb *b, const limb *m, int n, limb mprime, limb *t);
+	limb mont_inverse (limb m0);
+	void mont_r2 (limb *r, const limb *m, int n, limb mprime, limb *t);	// 2^(128n) mod m, t is n+2 limbs
+
+	void from32 (limb *r, const uint32_t *a, int n32);
+	void to32 (uint32_t *r, const limb *a, int n32);
+
+	void force_generic (bool generic);	// for tests and benchmarks
+	const char *impl ();
+}
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef _LIMB_POOL_H
+#define _LIMB_POOL_H
+
+#include <cstddef>
+#include <vector>
+
+/****************************************************************
+	Thread local pool for limb buffers
+
+	While the pool is on, requests are rounded up to power of two
+	size classes (32 bytes to 256 KiB, larger ones aren't pooled)
+	and released blocks stay on a free list of the calling thread,
+	so the next request of that class takes them back with no lock
+	and no trip to the global heap. While it is off blocks have the
+	requested size. Either way a small header records which kind a
+	block is.
+
+	set_enabled() turns the pool on for every thread, a scope object
+	for the calling thread until it is destroyed. A block may be
+	released by another thread than the one that allocated it, it
+	then joins that thread's free list. Free lists are capped per
+	class and handed back to the heap when the outermost scope ends
+	(unless the pool is on globally), when set_enabled(false) is
+	called on that thread or when the thread exits.
+****************************************************************/
+
+namespace limb_pool {
+
+	void *allocate (size_t bytes);
+	void deallocate (void *p, size_t bytes);
+
+	void set_enabled (bool on);
+	bool enabled ();		// globally or by a scope on the calling thread
+
+	class scope {
+		public:
+			scope ();
+			~scope ();
+			scope (const scope &) = delete;
+			scope &operator= (const scope &) = delete;
+	};
+
+	// Stateless, any two compare equal so containers swap and move buffers freely
+	template <typename T>
+	struct allocator {
+		typedef T value_type;
+
+		allocator () = default;
+		template <typename U> allocator (const allocator<U> &) {}
+
+		T *allocate (size_t n) { return static_cast<T *>(limb_pool::allocate(n * sizeof(T))); }
+		void deallocate (T *p, size_t n) { limb_pool::deallocate(p, n * sizeof(T)); }
+	};
+
+	template <typename T, typename U>
+	bool operator== (const allocator<T> &, const allocator<U> &) { return true; }
+	template <typename T, typename U>
+	bool operator!= (const allocator<T> &, const allocator<U> &) { return false; }
+
+	template <typename T>
+	using vector = std::vector<T, allocator<T>>;
+}
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef _SHAMIR_H
+#define _SHAMIR_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Shamir secret sharing over GF(2^8), byte wise over the whole secret.
+// Share i is the random degree threshold-1 polynomial with the secret as its
+// constant term evaluated at x = i+1, any threshold shares recover the secret.
+namespace shamir {
+
+	// shares[i] gets secret_bytes bytes, coefficients come from ctr_drbg::local()
+	void split (const uint8_t *secret, size_t secret_bytes, int threshold, int num_shares, uint8_t *const *shares);
+
+	// xs[i] is the x coordinate of shares[i], needs at least threshold distinct shares
+	void combine (uint8_t *secret, size_t secret_bytes, const uint8_t *xs, const uint8_t *const *shares, int num_shares);
+}
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef _THREAD_POOL_H
+#define _THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed size pool of worker threads used to spread independent pieces of
+// work (for eg. chunks of a large message) across cores.
+// parallel_for blocks until all tasks are done, the calling thread takes
+// part in the work as well.
+class thread_pool {
+
+	public:
+		thread_pool (int num_threads = 0);	// 0 - one thread per hardware core
+		~thread_pool ();
+
+		int size () const;
+		void parallel_for (int num_tasks, const std::function<void(int)> &task);
+
+	private:
+		void worker_loop ();
+		void run_tasks ();
+
+		std::vector<std::thread> workers;
+
+		std::mutex 				call_mtx;	// serializes parallel_for callers
+		std::mutex 				mtx;
+		std::condition_variable work_cv, done_cv;
+
+		const std::function<void(int)> *job = nullptr;
+		int 				num_job_tasks = 0;
+		std::atomic<int> 	next_task;
+		int 				num_active = 0;
+		uint64_t 			generation = 0;
+		bool 				stop = false;
+};
+
+#endif
@@ -0,0 +1,150 @@
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "instrument.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace {
+
+	// One per thread, fields are only written by the owning thread
+	struct thread_counters {
+		std::atomic<uint64_t> calls[INSTR_NUM_OPS], units[INSTR_NUM_OPS], cycles[INSTR_NUM_OPS];
+		std::atomic<uint64_t> hist[INSTR_NUM_OPS][INSTR_HIST_BUCKETS];
+
+		thread_counters ();
+		~thread_counters ();
+		void add_to (instr_snapshot &s) const;
+	};
+
+	std::mutex 						registry_mtx;
+	std::vector<thread_counters *> 	registry;
+	instr_snapshot 					retired;	// totals of exited threads
+	instr_snapshot 					baseline;	// totals at the last reset
+
+	thread_counters::thread_counters () {
+		for(int i=0; i<INSTR_NUM_OPS; i++) {
+			calls[i] = units[i] = cycles[i] = 0;
+			for(auto &h : hist[i])
+				h = 0;
+		}
+
+		std::lock_guard<std::mutex> lk(registry_mtx);
+		registry.push_back(this);
+	}
+
+	thread_counters::~thread_counters () {
+		std::lock_guard<std::mutex> lk(registry_mtx);
+		add_to(retired);
+		for(auto it = registry.begin(); it != registry.end(); it++) {
+			if (*it == this) {
+				registry.erase(it);
+				break;
+			}
+		}
+	}
+
+	void thread_counters::add_to (instr_snapshot &s) const {
+		for(int i=0; i<INSTR_NUM_OPS; i++) {
+			s.ops[i].calls 	+= calls[i].load(std::memory_order_relaxed);
+			s.ops[i].units 	+= units[i].load(std::memory_order_relaxed);
+			s.ops[i].cycles += cycles[i].load(std::memory_order_relaxed);
+			for(int b=0; b<INSTR_HIST_BUCKETS; b++)
+				s.ops[i].hist[b] += hist[i][b].load(std::memory_order_relaxed);
+		}
+	}
+
+	thread_counters &local () {
+		thread_local thread_counters c;
+		return c;
+	}
+
+	// Single writer, so a relaxed load and store is enough (no locked add)
+	inline void bump (std::atomic<uint64_t> &c, uint64_t n) {
+		c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+	}
+}
+
+bool instrument::enabled () {
+#ifdef LC_INSTRUMENT
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool instrument::cycles_enabled () {
+#if defined(LC_INSTRUMENT) && defined(LC_INSTRUMENT_CYCLES)
+	return true;
+#else
+	return false;
+#endif
+}
+
+const char *instrument::op_name (instr_op op) {
+	static const char *names[INSTR_NUM_OPS] = {
+		"encrypt_block", "decrypt_block", "generate_key_schedule", "mult_gmac", "ghash_mult", "incr_cntr",
+		"mont_mult", "mont_sqr"
+	};
+	return names[op];
+}
+
+instr_snapshot instrument::snapshot () {
+	instr_snapshot s = {};
+
+	std::lock_guard<std::mutex> lk(registry_mtx);
+	for(auto c : registry)
+		c->add_to(s);
+
+	for(int i=0; i<INSTR_NUM_OPS; i++) {
+		s.ops[i].calls 	+= retired.ops[i].calls - baseline.ops[i].calls;
+		s.ops[i].units 	+= retired.ops[i].units - baseline.ops[i].units;
+		s.ops[i].cycles += retired.ops[i].cycles - baseline.ops[i].cycles;
+		for(int b=0; b<INSTR_HIST_BUCKETS; b++)
+			s.ops[i].hist[b] += retired.ops[i].hist[b] - baseline.ops[i].hist[b];
+	}
+	return s;
+}
+
+void instrument::reset () {
+	instr_snapshot s = {};
+
+	std::lock_guard<std::mutex> lk(registry_mtx);
+	for(auto c : registry)
+		c->add_to(s);
+
+	for(int i=0; i<INSTR_NUM_OPS; i++) {
+		baseline.ops[i].calls 	= s.ops[i].calls + retired.ops[i].calls;
+		baseline.ops[i].units 	= s.ops[i].units + retired.ops[i].units;
+		baseline.ops[i].cycles 	= s.ops[i].cycles + retired.ops[i].cycles;
+		for(int b=0; b<INSTR_HIST_BUCKETS; b++)
+			baseline.ops[i].hist[b] = s.ops[i].hist[b] + retired.ops[i].hist[b];
+	}
+}
+
+void instrument::count (instr_op op, uint64_t units) {
+	thread_counters &c = local();
+	bump(c.calls[op], 1);
+	bump(c.units[op], units);
+}
+
+void instrument::record (instr_op op, uint64_t units, uint64_t cycles) {
+	thread_counters &c = local();
+	bump(c.calls[op], 1);
+	bump(c.units[op], units);
+	bump(c.cycles[op], cycles);
+
+	int bucket = cycles ? 63 - __builtin_clzll(cycles) : 0;
+	bump(c.hist[op][bucket < INSTR_HIST_BUCKETS ? bucket : INSTR_HIST_BUCKETS-1], 1);
+}
+
+uint64_t instrument::cycle_count () {
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
@@ -0,0 +1,605 @@
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "limb64.h"
+#include "limb_pool.h"
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#define HAVE_ADX_PATH
+#endif
+
+typedef unsigned __int128 dlimb;
+
+using limb64::limb;
+
+namespace {
+
+	limb addmul_1_generic (limb *r, const limb *a, int n, limb b) {
+		limb carry = 0;
+		for(int i=0; i<n; i++) {
+			dlimb t = (dlimb) a[i] * b + r[i] + carry;
+			r[i] = (limb) t;
+			carry = t >> 64;
+		}
+		return carry;
+	}
+
+#ifdef HAVE_ADX_PATH
+	// Two independent carry chains - ADOX adds the previous high half to the low half,
+	// ADCX adds the result into r, MULX touches neither flag. Compilers don't emit
+	// ADCX/ADOX from the intrinsics, so the loop is written out, four limbs per pass.
+	// LEA and JRCXZ keep both flags live across passes, the leftover limbs go first
+	// through the generic kernel and its carry enters as the first high half
+	limb addmul_1_adx (limb *r, const limb *a, int n, limb b) {
+		int head = n % 4;
+		limb carry = addmul_1_generic(r, a, head, b);
+		r += head;
+		a += head;
+
+		long passes = n / 4;
+		limb lo, hi;
+		__asm__ volatile (
+			"xor %k[lo], %k[lo]\n\t"		// clears CF and OF
+			"1:\n\t"
+			"jrcxz 2f\n\t"
+			"mulx (%[a]), %[lo], %[hi]\n\t"
+			"adox %[c], %[lo]\n\t"
+			"adcx (%[r]), %[lo]\n\t"
+			"mov %[lo], (%[r])\n\t"
+			"mulx 8(%[a]), %[lo], %[c]\n\t"
+			"adox %[hi], %[lo]\n\t"
+			"adcx 8(%[r]), %[lo]\n\t"
+			"mov %[lo], 8(%[r])\n\t"
+			"mulx 16(%[a]), %[lo], %[hi]\n\t"
+			"adox %[c], %[lo]\n\t"
+			"adcx 16(%[r]), %[lo]\n\t"
+			"mov %[lo], 16(%[r])\n\t"
+			"mulx 24(%[a]), %[lo], %[c]\n\t"
+			"adox %[hi], %[lo]\n\t"
+			"adcx 24(%[r]), %[lo]\n\t"
+			"mov %[lo], 24(%[r])\n\t"
+			"lea 32(%[a]), %[a]\n\t"
+			"lea 32(%[r]), %[r]\n\t"
+			"lea -1(%%rcx), %%rcx\n\t"
+			"jmp 1b\n\t"
+			"2:\n\t"
+			"mov $0, %k[lo]\n\t"			// both chains end in the last high half
+			"adox %[lo], %[c]\n\t"
+			"adcx %[lo], %[c]\n\t"
+			: [c] "+&r" (carry), [a] "+&r" (a), [r] "+&r" (r), "+&c" (passes), [lo] "=&r" (lo), [hi] "=&r" (hi)
+			: "d" (b)
+			: "cc", "memory");
+		return carry;
+	}
+
+	bool cpu_has_adx () {
+		unsigned int eax, ebx, ecx, edx;
+		if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+			return false;
+		return (ebx & (1 << 8)) && (ebx & (1 << 19));	// BMI2, ADX
+	}
+#endif
+
+	struct limb64_dispatch {
+		limb (*addmul_1) (limb *, const limb *, int, limb) = addmul_1_generic;
+		const char *name = "int128";
+		bool has_adx = false;
+
+		limb64_dispatch () {
+#ifdef HAVE_ADX_PATH
+			has_adx = cpu_has_adx();
+#endif
+			select(false);
+		}
+
+		void select (bool generic) {
+			addmul_1 = addmul_1_generic;
+			name = "int128";
+#ifdef HAVE_ADX_PATH
+			if (has_adx && !generic) {
+				addmul_1 = addmul_1_adx;
+				name = "mulx/adcx/adox";
+			}
+#endif
+		}
+	};
+
+	limb64_dispatch kernels;
+}
+
+limb limb64::add_n (limb *r, const limb *a, const limb *b, int n) {
+	limb carry = 0;
+	for(int i=0; i<n; i++) {
+		dlimb t = (dlimb) a[i] + b[i] + carry;
+		r[i] = (limb) t;
+		carry = t >> 64;
+	}
+	return carry;
+}
+
+limb limb64::sub_n (limb *r, const limb *a, const limb *b, int n) {
+	limb borrow = 0;
+	for(int i=0; i<n; i++) {
+		dlimb t = (dlimb) a[i] - b[i] - borrow;
+		r[i] = (limb) t;
+		borrow = (t >> 64) & 0x1;
+	}
+	return borrow;
+}
+
+limb limb64::addmul_1 (limb *r, const limb *a, int n, limb b) {
+	return kernels.addmul_1(r, a, n, b);
+}
+
+/**********************************************************************
+
+	Subquadratic multiplication
+
+	Balanced products recurse - schoolbook below karatsuba_threshold
+	limbs, Karatsuba up to toom3_threshold and Toom-3 above. When both
+	operands are the same pointer every level squares instead, the
+	schoolbook square computes each cross product once and doubles. Every
+	level carves its temporaries off the front of one scratch buffer
+	and hands the rest down, 8n limbs cover any depth as long as the
+	thresholds stay at or above 4 and 25 limbs.
+
+	Intermediate values that may go negative are kept in two's
+	complement at a fixed width, the final coefficients are all
+	positive and fit in that width so the wrapped arithmetic is exact.
+
+	The thresholds come from bench_mul.
+
+***********************************************************************/
+
+namespace {
+
+	int karatsuba_threshold = 32;
+	int toom3_threshold = 112;
+
+	// r[0..rn) += a[0..an), an <= rn, returns the carry out of r
+	limb add_into (limb *r, int rn, const limb *a, int an) {
+		limb carry = limb64::add_n(r, r, a, an);
+		for(int i=an; carry && i<rn; i++) {
+			r[i] += carry;
+			carry = (r[i] == 0);
+		}
+		return carry;
+	}
+
+	limb sub_into (limb *r, int rn, const limb *a, int an) {
+		limb borrow = limb64::sub_n(r, r, a, an);
+		for(int i=an; borrow && i<rn; i++) {
+			borrow = (r[i] == 0);
+			r[i] -= 1;
+		}
+		return borrow;
+	}
+
+	void neg_n (limb *r, int n) {
+		limb carry = 1;
+		for(int i=0; i<n; i++) {
+			r[i] = ~r[i] + carry;
+			carry = carry && (r[i] == 0);
+		}
+	}
+
+	// r = |r - a|, returns true when a was the larger one
+	bool sub_abs (limb *r, int rn, const limb *a, int an) {
+		if(!sub_into(r, rn, a, an))
+			return false;
+		neg_n(r, rn);
+		return true;
+	}
+
+	// Arithmetic shift right by one
+	void sar_1 (limb *r, int n) {
+		for(int i=0; i<n-1; i++)
+			r[i] = (r[i] >> 1) | (r[i+1] << 63);
+		r[n-1] = (limb) ((int64_t) r[n-1] >> 1);
+	}
+
+	// r = r/3 for an exact multiple of 3, Hensel style so it also holds for negatives mod 2^(64n)
+	void divexact_3 (limb *r, int n) {
+		const limb inv3 = 0xAAAAAAAAAAAAAAABULL;
+		limb borrow = 0;
+		for(int i=0; i<n; i++) {
+			limb x = r[i];
+			limb b = x < borrow;
+			limb q = (x - borrow) * inv3;
+			r[i] = q;
+			borrow = b + (limb) (((dlimb) q * 3) >> 64);
+		}
+	}
+
+	// Top bit of a two's complement value, magnitude left in place
+	bool abs_n (limb *r, int n) {
+		if(!(r[n-1] >> 63))
+			return false;
+		neg_n(r, n);
+		return true;
+	}
+
+	void mul_basecase (limb *r, const limb *a, int na, const limb *b, int nb) {
+		std::memset(r, 0, (na+nb)*sizeof(limb));
+		for(int i=0; i<nb; i++)
+			r[na+i] = kernels.addmul_1(r+i, a, na, b[i]);
+	}
+
+	// Cross products a[i]*a[j], i<j, once - then doubled and the diagonal added
+	void sqr_basecase (limb *r, const limb *a, int n) {
+		std::memset(r, 0, 2*n*sizeof(limb));
+		for(int i=0; i<n-1; i++)
+			r[n+i] = kernels.addmul_1(r+2*i+1, a+i+1, n-i-1, a[i]);
+
+		limb top = 0;
+		for(int i=0; i<2*n; i++) {
+			limb v = r[i];
+			r[i] = (v << 1) | top;
+			top = v >> 63;
+		}
+
+		limb carry = 0;
+		for(int i=0; i<n; i++) {
+			dlimb sq = (dlimb) a[i] * a[i];
+			dlimb t = (dlimb) r[2*i] + (limb) sq + carry;
+			r[2*i] = (limb) t;
+			t = (dlimb) r[2*i+1] + (limb) (sq >> 64) + (limb) (t >> 64);
+			r[2*i+1] = (limb) t;
+			carry = t >> 64;
+		}
+	}
+
+	void mul_rec (limb *r, const limb *a, const limb *b, int n, limb *scratch);
+
+	// z1 = z0 + z2 - (a1-a0)(b1-b0), the difference product is done on magnitudes
+	void mul_karatsuba (limb *r, const limb *a, const limb *b, int n, limb *scratch) {
+		int h = n/2, hh = n - h;
+		bool square = (a == b);
+		limb *da = scratch, *db = da + hh, *t = db + hh, *next = t + 2*hh + 1;
+
+		std::memcpy(da, a+h, hh*sizeof(limb));
+		bool neg = sub_abs(da, hh, a, h);
+		if(square) {
+			db = da;
+			neg = false;
+		} else {
+			std::memcpy(db, b+h, hh*sizeof(limb));
+			neg ^= sub_abs(db, hh, b, h);
+		}
+
+		mul_rec(r, a, b, h, next);
+		mul_rec(r + 2*h, a+h, b+h, hh, next);
+		mul_rec(t, da, db, hh, next);
+		t[2*hh] = 0;
+
+		if(!neg)
+			neg_n(t, 2*hh+1);
+		add_into(t, 2*hh+1, r, 2*h);
+		add_into(t, 2*hh+1, r + 2*h, 2*hh);
+		add_into(r + h, 2*n - h, t, 2*hh+1);
+	}
+
+	// Evaluation at 0, 1, -1, -2, inf with Bodrato's interpolation sequence
+	void mul_toom3 (limb *r, const limb *a, const limb *b, int n, limb *scratch) {
+		int k = (n+2)/3, l = n - 2*k;
+		int e = k+1, w = 2*e;
+		bool square = (a == b);
+		const limb *a0 = a, *a1 = a+k, *a2 = a+2*k;
+		const limb *b0 = b, *b1 = b+k, *b2 = b+2*k;
+
+		limb *pa1 = scratch, *pam1 = pa1 + e, *pam2 = pam1 + e;
+		limb *pb1 = pam2 + e, *pbm1 = pb1 + e, *pbm2 = pbm1 + e;
+		limb *w1 = pbm2 + e, *wm1 = w1 + w, *wm2 = wm1 + w;
+		limb *next = wm2 + w;
+
+		auto evaluate = [&] (limb *p1, limb *pm1, limb *pm2, const limb *x0, const limb *x1, const limb *x2) {
+			// pm1 = x0 + x2 - x1, pm2 = 2(pm1 + x2) - x0, both two's complement
+			std::memset(pm1, 0, e*sizeof(limb));
+			std::memcpy(pm1, x0, k*sizeof(limb));
+			add_into(pm1, e, x2, l);
+			std::memcpy(p1, pm1, e*sizeof(limb));
+			add_into(p1, e, x1, k);
+			sub_into(pm1, e, x1, k);
+
+			std::memcpy(pm2, pm1, e*sizeof(limb));
+			add_into(pm2, e, x2, l);
+			add_into(pm2, e, pm2, e);
+			sub_into(pm2, e, x0, k);
+		};
+		evaluate(pa1, pam1, pam2, a0, a1, a2);
+		bool neg1 = abs_n(pam1, e), neg2 = abs_n(pam2, e);
+
+		if(square) {
+			pb1 = pa1; pbm1 = pam1; pbm2 = pam2;
+			neg1 = neg2 = false;
+		} else {
+			evaluate(pb1, pbm1, pbm2, b0, b1, b2);
+			neg1 ^= abs_n(pbm1, e);
+			neg2 ^= abs_n(pbm2, e);
+		}
+
+		mul_rec(w1, pa1, pb1, e, next);
+		mul_rec(wm1, pam1, pbm1, e, next);
+		mul_rec(wm2, pam2, pbm2, e, next);
+		if(neg1)
+			neg_n(wm1, w);
+		if(neg2)
+			neg_n(wm2, w);
+
+		// r0 and rinf go straight to their place in r
+		limb *r0 = r, *rinf = r + 4*k;
+		mul_rec(r0, a0, b0, k, next);
+		mul_rec(rinf, a2, b2, l, next);
+		std::memset(r + 2*k, 0, 2*k*sizeof(limb));
+
+		sub_into(wm2, w, w1, w);		// r3 = (r(-2) - r(1))/3
+		divexact_3(wm2, w);
+		sub_into(w1, w, wm1, w);		// r1 = (r(1) - r(-1))/2
+		sar_1(w1, w);
+		sub_into(wm1, w, r0, 2*k);		// r2 = r(-1) - r(0)
+		neg_n(wm2, w);					// r3 = (r2 - r3)/2 + 2 rinf
+		add_into(wm2, w, wm1, w);
+		sar_1(wm2, w);
+		add_into(wm2, w, rinf, 2*l);
+		add_into(wm2, w, rinf, 2*l);
+		add_into(wm1, w, w1, w);		// r2 = r2 + r1 - rinf
+		sub_into(wm1, w, rinf, 2*l);
+		sub_into(w1, w, wm2, w);		// r1 = r1 - r3
+
+		add_into(r + k, 2*n - k, w1, w);
+		add_into(r + 2*k, 2*n - 2*k, wm1, w);
+		add_into(r + 3*k, 2*n - 3*k, wm2, std::min(w, 2*n - 3*k));
+	}
+
+	void mul_rec (limb *r, const limb *a, const limb *b, int n, limb *scratch) {
+		if(n < karatsuba_threshold && a == b)
+			sqr_basecase(r, a, n);
+		else if(n < karatsuba_threshold)
+			mul_basecase(r, a, n, b, n);
+		else if(n < toom3_threshold)
+			mul_karatsuba(r, a, b, n, scratch);
+		else
+			mul_toom3(r, a, b, n, scratch);
+	}
+}
+
+void limb64::mul_n (limb *r, const limb *a, const limb *b, int n, limb *scratch) {
+	mul_rec(r, a, b, n, scratch);
+}
+
+void limb64::mul (limb *r, const limb *a, int na, const limb *b, int nb) {
+	if(na < nb) {
+		std::swap(a, b);
+		std::swap(na, nb);
+	}
+
+	if(nb < karatsuba_threshold) {
+		mul_basecase(r, a, na, b, nb);
+		return;
+	}
+
+	// Close to balanced - zero extend b and drop the empty top of the product
+	if(2*nb > na) {
+		limb_pool::vector<limb> scratch(na + 2*na + mul_n_scratch(na));
+		limb *bb = scratch.data(), *t = bb + na;
+		std::memcpy(bb, b, nb*sizeof(limb));
+		std::memset(bb + nb, 0, (na-nb)*sizeof(limb));
+		mul_n(t, a, bb, na, t + 2*na);
+		std::memcpy(r, t, (na+nb)*sizeof(limb));
+		return;
+	}
+
+	// Otherwise a is cut into nb limb slices, each a balanced product added into r
+	limb_pool::vector<limb> scratch(nb + 2*nb + mul_n_scratch(nb));
+	limb *slice = scratch.data(), *t = slice + nb;
+	std::memset(r, 0, (na+nb)*sizeof(limb));
+
+	for(int i=0; i<na; i+=nb) {
+		int len = std::min(nb, na-i);
+		if(len < karatsuba_threshold) {
+			for(int j=0; j<len; j++) {
+				limb carry = kernels.addmul_1(r+i+j, b, nb, a[i+j]);
+				add_into(r+i+j+nb, na-i-j, &carry, 1);
+			}
+			continue;
+		}
+		std::memset(slice, 0, nb*sizeof(limb));
+		std::memcpy(slice, a+i, len*sizeof(limb));
+		mul_n(t, slice, b, nb, t + 2*nb);
+		add_into(r+i, na+nb-i, t, len+nb);
+	}
+}
+
+void limb64::sqr_n (limb *r, const limb *a, int n, limb *scratch) {
+	mul_rec(r, a, a, n, scratch);
+}
+
+void limb64::sqr (limb *r, const limb *a, int n) {
+	if(n < karatsuba_threshold) {
+		sqr_basecase(r, a, n);
+		return;
+	}
+	limb_pool::vector<limb> scratch(mul_n_scratch(n));
+	mul_rec(r, a, a, n, scratch.data());
+}
+
+// Knuth Algorithm D - the divisor is shifted so its top bit is set, which keeps every quotient
+// estimate from the top two limbs at most 2 too large (one correction from the 3rd limb, one add back)
+void limb64::divrem (limb *q, limb *r, const limb *a, int na, const limb *d, int nd) {
+	if(na < nd) {
+		q[0] = 0;
+		std::memcpy(r, a, na*sizeof(limb));
+		std::memset(r + na, 0, (nd-na)*sizeof(limb));
+		return;
+	}
+
+	if(nd == 1) {
+		limb rem = 0;
+		for(int j=na-1; j>=0; j--) {
+			dlimb num = ((dlimb) rem << 64) | a[j];
+			q[j] = (limb) (num / d[0]);
+			rem = (limb) (num % d[0]);
+		}
+		r[0] = rem;
+		return;
+	}
+
+	int s = __builtin_clzll(d[nd-1]);
+	limb_pool::vector<limb> work(na + 1 + nd);
+	limb *un = work.data(), *vn = un + na + 1;
+
+	for(int i=nd-1; i>0; i--)
+		vn[i] = (d[i] << s) | (s ? d[i-1] >> (64-s) : 0);
+	vn[0] = d[0] << s;
+	un[na] = s ? a[na-1] >> (64-s) : 0;
+	for(int i=na-1; i>0; i--)
+		un[i] = (a[i] << s) | (s ? a[i-1] >> (64-s) : 0);
+	un[0] = a[0] << s;
+
+	for(int j=na-nd; j>=0; j--) {
+		dlimb num = ((dlimb) un[j+nd] << 64) | un[j+nd-1];
+		dlimb qhat = num / vn[nd-1];
+		dlimb rhat = num % vn[nd-1];
+
+		while((qhat >> 64) || qhat * vn[nd-2] > ((rhat << 64) | un[j+nd-2])) {
+			qhat--;
+			rhat += vn[nd-1];
+			if(rhat >> 64)
+				break;
+		}
+
+		// un[j..j+nd] -= qhat * vn
+		limb k = 0;
+		for(int i=0; i<nd; i++) {
+			dlimb p = (dlimb) (limb) qhat * vn[i] + k;
+			limb lo = (limb) p, old = un[i+j];
+			un[i+j] = old - lo;
+			k = (limb) (p >> 64) + (old < lo);
+		}
+		limb top = un[j+nd];
+		un[j+nd] = top - k;
+
+		q[j] = (limb) qhat;
+		if(top < k) {
+			q[j]--;
+			un[j+nd] += add_n(un+j, un+j, vn, nd);
+		}
+	}
+
+	for(int i=0; i<nd-1; i++)
+		r[i] = (un[i] >> s) | (s ? un[i+1] << (64-s) : 0);
+	r[nd-1] = un[nd-1] >> s;
+}
+
+void limb64::set_mul_thresholds (int karatsuba, int toom3) {
+	karatsuba_threshold = std::max(karatsuba, 4);
+	toom3_threshold = std::max(toom3, 25);
+}
+
+// One limb of t is cleared per step, its carry ripples into the upper half
+void limb64::redc (limb *r, limb *t, const limb *m, int n, limb mprime) {
+	for(int i=0; i<n; i++) {
+		limb carry = kernels.addmul_1(t+i, m, n, t[i]*mprime);
+		for(int k=i+n; carry && k<2*n+1; k++) {
+			t[k] += carry;
+			carry = t[k] < carry;
+		}
+	}
+
+	// t/R < 2m - subtract m and keep the difference unless it borrowed without a top limb
+	limb borrow = sub_n(r, t+n, m, n);
+	limb keep_t = (limb) 0 - (borrow & (t[2*n] == 0));
+	for(int i=0; i<n; i++)
+		r[i] = (r[i] & ~keep_t) | (t[n+i] & keep_t);
+}
+
+// CIOS - one limb of b is multiplied in and one limb reduced per step, so t never grows past n+2 limbs
+void limb64::mont_mul (limb *r, const limb *a, const limb *b, const limb *m, int n, limb n0, limb *t) {
+	std::memset(t, 0, (n+2)*sizeof(limb));
+
+	for(int i=0; i<n; i++) {
+		dlimb c = (dlimb) t[n] + kernels.addmul_1(t, a, n, b[i]);
+		t[n] = (limb) c;
+		t[n+1] = (limb) (c >> 64);
+
+		c = (dlimb) t[n] + kernels.addmul_1(t, m, n, t[0]*n0);
+		t[n] = (limb) c;
+		t[n+1] += (limb) (c >> 64);
+
+		// t[0] is zero now, divide by 2^64
+		std::memmove(t, t+1, (n+1)*sizeof(limb));
+		t[n+1] = 0;
+	}
+
+	// t < 2m - same masked final subtraction as redc
+	limb borrow = sub_n(r, t, m, n);
+	limb keep_t = (limb) 0 - (borrow & (t[n] == 0));
+	for(int i=0; i<n; i++)
+		r[i] = (r[i] & ~keep_t) | (t[i] & keep_t);
+}
+
+// R^2 = 2^(128n) mod m. Doubling from the top bit of m gives 2^j R mod m with j the odd part of 64n,
+// each Montgomery square then doubles j until it reaches 64n. Doubling is at most one subtract per step.
+// m may be narrower than n limbs, the top bit is searched from the highest nonzero limb
+void limb64::mont_r2 (limb *r, const limb *m, int n, limb mprime, limb *t) {
+	int hi_limb = n-1;
+	while(m[hi_limb] == 0)
+		hi_limb--;		// m is odd, limb 0 stops the search
+	int top = 64*hi_limb + 63 - __builtin_clzll(m[hi_limb]);
+	std::memset(r, 0, n*sizeof(limb));
+	if(top == 0)
+		return;		// m == 1
+	r[top/64] = (limb) 1 << (top%64);
+
+	int j = 64*n, num_sqr = 0;
+	while(j % 2 == 0) {
+		j /= 2;
+		num_sqr++;
+	}
+
+	for(int i=top; i<64*n + j; i++) {
+		limb hi = r[n-1] >> 63;
+		for(int k=n-1; k>0; k--)
+			r[k] = (r[k] << 1) | (r[k-1] >> 63);
+		r[0] <<= 1;
+
+		int k = n-1;
+		while(k > 0 && r[k] == m[k])
+			k--;
+		if(hi || r[k] >= m[k])
+			sub_n(r, r, m, n);
+	}
+
+	for(int i=0; i<num_sqr; i++)
+		mont_mul(r, r, r, m, n, mprime, t);
+}
+
+// Newton's iteration, each step doubles the correct low bits (odd m0 starts with 3)
+limb limb64::mont_inverse (limb m0) {
+	limb inv = m0;
+	for(int i=0; i<5; i++)
+		inv *= 2 - m0*inv;
+	return -inv;
+}
+
+void limb64::from32 (limb *r, const uint32_t *a, int n32) {
+	for(int i=0; i<n32/2; i++)
+		r[i] = a[2*i] | ((limb) a[2*i+1] << 32);
+	if (n32 % 2)
+		r[n32/2] = a[n32-1];
+}
+
+void limb64::to32 (uint32_t *r, const limb *a, int n32) {
+	for(int i=0; i<n32; i++)
+		r[i] = (uint32_t) (a[i/2] >> (32*(i%2)));
+}
+
+void limb64::force_generic (bool generic) {
+	kernels.select(generic);
+}
+
+const char *limb64::impl () {
+	return kernels.name;
+}
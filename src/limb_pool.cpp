@@ -0,0 +1,134 @@
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <new>
+
+#include "limb_pool.h"
+
+namespace {
+
+	const int min_shift = 5, max_shift = 18;
+	const int num_classes = max_shift - min_shift + 1;
+	const size_t class_budget = 256*1024;	// bytes kept per class, at least min_cached blocks
+	const int min_cached = 8;
+	const int unpooled = -1;
+
+	// In front of every block, keeps the payload aligned like operator new's
+	struct alignas(alignof(std::max_align_t)) block_header {
+		int size_class;		// unpooled for exact size blocks
+	};
+
+	struct free_block {
+		free_block *next;
+	};
+
+	// Only touched by the owning thread
+	struct local_pool {
+		free_block *head[num_classes] = {};
+		int count[num_classes] = {};
+
+		void drain ();
+		~local_pool ();
+	};
+
+	std::atomic<bool> global_on (false);
+	thread_local int scope_depth = 0;
+	thread_local bool pool_gone = false;	// trivially destructible, still readable after local_pool is
+
+	inline block_header *header_of (void *payload) {
+		return static_cast<block_header *>(payload) - 1;
+	}
+
+	void local_pool::drain () {
+		for(int c=0; c<num_classes; c++) {
+			while(head[c]) {
+				free_block *b = head[c];
+				head[c] = b->next;
+				::operator delete(header_of(b));
+			}
+			count[c] = 0;
+		}
+	}
+
+	local_pool::~local_pool () {
+		pool_gone = true;
+		drain();
+	}
+
+	local_pool &local () {
+		thread_local local_pool p;
+		return p;
+	}
+
+	// Size class of a request, unpooled above the largest
+	inline int size_class (size_t bytes) {
+		if(bytes <= ((size_t) 1 << min_shift))
+			return 0;
+		int shift = 64 - __builtin_clzll(bytes - 1);
+		return shift > max_shift ? unpooled : shift - min_shift;
+	}
+
+	inline bool pool_usable () {
+		return !pool_gone && (scope_depth > 0 || global_on.load(std::memory_order_relaxed));
+	}
+
+	inline void *new_block (size_t bytes, int size_class) {
+		block_header *h = static_cast<block_header *>(::operator new(sizeof(block_header) + bytes));
+		h->size_class = size_class;
+		return h + 1;
+	}
+}
+
+// While the pool is off blocks are allocated at the requested size, the header tells
+// deallocate whether a block can go on a free list
+void *limb_pool::allocate (size_t bytes) {
+	int c = size_class(bytes);
+	if(c == unpooled || !pool_usable())
+		return new_block(bytes, unpooled);
+
+	local_pool &p = local();
+	if(free_block *b = p.head[c]) {
+		p.head[c] = b->next;
+		p.count[c]--;
+		return b;
+	}
+	return new_block((size_t) 1 << (c + min_shift), c);
+}
+
+void limb_pool::deallocate (void *ptr, size_t) {
+	int c = header_of(ptr)->size_class;
+
+	if(c != unpooled && pool_usable()) {
+		local_pool &p = local();
+		int cap = std::max(min_cached, (int) (class_budget >> (c + min_shift)));
+		if(p.count[c] < cap) {
+			free_block *b = static_cast<free_block *>(ptr);
+			b->next = p.head[c];
+			p.head[c] = b;
+			p.count[c]++;
+			return;
+		}
+	}
+	::operator delete(header_of(ptr));
+}
+
+// Other threads' lists are released when they leave their scopes or exit
+void limb_pool::set_enabled (bool on) {
+	global_on.store(on, std::memory_order_relaxed);
+	if(!on && scope_depth == 0 && !pool_gone)
+		local().drain();
+}
+
+bool limb_pool::enabled () {
+	return pool_usable();
+}
+
+limb_pool::scope::scope () {
+	scope_depth++;
+}
+
+// Leaving the outermost scope hands the calling thread's free blocks back to the heap
+limb_pool::scope::~scope () {
+	if(--scope_depth == 0 && !global_on.load(std::memory_order_relaxed) && !pool_gone)
+		local().drain();
+}
@@ -0,0 +1,62 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "common_utils.h"
+#include "ctr_drbg.h"
+#include "shamir.h"
+
+using namespace gf2_8_math;
+
+void shamir::split (const uint8_t *secret, size_t secret_bytes, int threshold, int num_shares, uint8_t *const *shares) {
+	if (threshold < 1 || threshold > num_shares || num_shares > 255) {
+		std::cout << "Invalid Shamir parameters " << threshold << " of " << num_shares << std::endl;
+		std::exit(EXIT_FAILURE);
+	}
+
+	std::vector<uint8_t> coeffs((threshold-1)*secret_bytes);
+	ctr_drbg::local().fill(coeffs.data(), coeffs.size());
+
+	// share = secret + sum a_k x^k, one multiply accumulate pass per coefficient
+	for(int i=0; i<num_shares; i++) {
+		uint8_t x = i+1, xk = 1;
+		std::memcpy(shares[i], secret, secret_bytes);
+
+		for(int k=1; k<threshold; k++) {
+			xk = mul(xk, x);
+			mul_acc_buf(shares[i], coeffs.data() + (k-1)*secret_bytes, xk, secret_bytes);
+		}
+	}
+
+	std::memset(coeffs.data(), 0, coeffs.size());
+}
+
+void shamir::combine (uint8_t *secret, size_t secret_bytes, const uint8_t *xs, const uint8_t *const *shares, int num_shares) {
+	for(int i=0; i<num_shares; i++) {
+		if (xs[i] == 0) {
+			std::cout << "Invalid Shamir share coordinates" << std::endl;
+			std::exit(EXIT_FAILURE);
+		}
+	}
+
+	std::memset(secret, 0, secret_bytes);
+
+	// Lagrange interpolation at 0 - secret = sum y_i * prod x_j / (x_j - x_i)
+	for(int i=0; i<num_shares; i++) {
+		uint8_t num = 1, den = 1;
+
+		for(int j=0; j<num_shares; j++) {
+			if (j == i)
+				continue;
+			if (xs[j] == xs[i]) {
+				std::cout << "Invalid Shamir share coordinates" << std::endl;
+				std::exit(EXIT_FAILURE);
+			}
+			num = mul(num, xs[j]);
+			den = mul(den, xs[j] ^ xs[i]);
+		}
+
+		mul_acc_buf(secret, shares[i], mul(num, inv(den)), secret_bytes);
+	}
+}
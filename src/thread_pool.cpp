@@ -0,0 +1,81 @@
+#include <algorithm>
+
+#include "thread_pool.h"
+
+thread_pool::thread_pool (int num_threads) : next_task(0) {
+	if (num_threads <= 0)
+		num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+	// Calling thread is one of the workers
+	for(int i=1; i<num_threads; i++)
+		workers.emplace_back(&thread_pool::worker_loop, this);
+}
+
+thread_pool::~thread_pool () {
+	{
+		std::lock_guard<std::mutex> lk(mtx);
+		stop = true;
+	}
+	work_cv.notify_all();
+
+	for(auto &t : workers)
+		t.join();
+}
+
+int thread_pool::size () const {
+	return workers.size() + 1;
+}
+
+// Runs task(0) ... task(num_tasks-1), returns once all of them are finished
+void thread_pool::parallel_for (int num_tasks, const std::function<void(int)> &task) {
+
+	std::lock_guard<std::mutex> call_lk(call_mtx);
+
+	if (workers.empty() || num_tasks <= 1) {
+		for(int i=0; i<num_tasks; i++)
+			task(i);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lk(mtx);
+		job = &task;
+		num_job_tasks = num_tasks;
+		next_task = 0;
+		num_active = workers.size();
+		generation++;
+	}
+	work_cv.notify_all();
+
+	run_tasks();
+
+	std::unique_lock<std::mutex> lk(mtx);
+	done_cv.wait(lk, [this] { return num_active == 0; });
+	job = nullptr;
+}
+
+void thread_pool::run_tasks () {
+	int i;
+	while ((i = next_task++) < num_job_tasks)
+		(*job)(i);
+}
+
+void thread_pool::worker_loop () {
+	uint64_t seen = 0;
+
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lk(mtx);
+			work_cv.wait(lk, [&] { return stop || generation != seen; });
+			if (stop)
+				return;
+			seen = generation;
+		}
+
+		run_tasks();
+
+		std::lock_guard<std::mutex> lk(mtx);
+		if (--num_active == 0)
+			done_cv.notify_one();
+	}
+}
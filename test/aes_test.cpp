@@ -3,16 +3,45 @@
 #include <cstring>
 #include <string>
 #include <vector>
-#include "yaml-cpp/yaml.h"
+#include <algorithm>
+#include <future>
 #include <assert.h>
+#include <chrono>
+#include <map>
+#include <thread>
 
 #include "aes_block_cipher.h"
+#include "aes_gcm_stream.h"
+#include "aes_job_mgr.h"
+#include "ctr_drbg.h"
+#include "instrument.h"
 #include "common_utils.h"
+#include "shamir.h"
+#include "test_vectors.h"
 
-void test_ecb (YAML::Node node) {
-	std::vector<uint8_t> ct = str2vec(node["ct"].as<std::string>().c_str());
-	std::vector<uint8_t> pt = str2vec(node["pt"].as<std::string>().c_str());
-	std::vector<uint8_t> key = str2vec(node["key"].as<std::string>().c_str());
+aes_job_mgr job_mgr(4, 200);
+
+// Submits copies of a job to the job queue so they get batched, every output must match
+void check_jobs (aes_job job, tv_bytes expected, int num_jobs = 3) {
+	std::vector<std::vector<uint8_t>> out(num_jobs, std::vector<uint8_t>(expected.size(),0));
+	std::vector<std::future<bool>> res;
+
+	for(int i=0; i<num_jobs; i++) {
+		job.dst = out[i].data();
+		res.push_back(job_mgr.submit(job));
+	}
+
+	for(int i=0; i<num_jobs; i++) {
+		bool ok = res[i].get();
+		assert(ok);
+		assert(out[i] == expected);
+	}
+}
+
+void test_ecb (const test_vector &node) {
+	tv_bytes ct = node.bytes("ct");
+	tv_bytes pt = node.bytes("pt");
+	tv_bytes key = node.bytes("key");
 
 	int keylen = key.size();
 	int ptlen = pt.size();
@@ -25,12 +54,15 @@ void test_ecb (YAML::Node node) {
 	cipher.decrypt(temp.data(),ct.data(),ptlen/16);
 	assert(temp == pt);
 
+	aes_job_key job_key(keylen*8, key.data());
+	check_jobs({ AES_JOB_ECB_ENC, &job_key, nullptr, nullptr, pt.data(), nullptr, nullptr, 0, ptlen }, ct);
+	check_jobs({ AES_JOB_ECB_DEC, &job_key, nullptr, nullptr, ct.data(), nullptr, nullptr, 0, ptlen }, pt);
 }
-void test_cbc (YAML::Node node) {
-	std::vector<uint8_t> ct = str2vec(node["ct"].as<std::string>().c_str());
-	std::vector<uint8_t> pt = str2vec(node["pt"].as<std::string>().c_str());
-	std::vector<uint8_t> iv = str2vec(node["iv"].as<std::string>().c_str());
-	std::vector<uint8_t> key = str2vec(node["key"].as<std::string>().c_str());
+void test_cbc (const test_vector &node) {
+	tv_bytes ct = node.bytes("ct");
+	tv_bytes pt = node.bytes("pt");
+	tv_bytes iv = node.bytes("iv");
+	tv_bytes key = node.bytes("key");
 
 	int keylen = key.size();
 	int ptlen = pt.size();
@@ -42,12 +74,16 @@ void test_cbc (YAML::Node node) {
 	assert(temp == ct);
 	cipher.decrypt(temp.data(),ct.data(),iv.data(),ptlen/16);
 	assert(temp == pt);
+
+	aes_job_key job_key(keylen*8, key.data());
+	check_jobs({ AES_JOB_CBC_ENC, &job_key, iv.data(), nullptr, pt.data(), nullptr, nullptr, 0, ptlen }, ct);
+	check_jobs({ AES_JOB_CBC_DEC, &job_key, iv.data(), nullptr, ct.data(), nullptr, nullptr, 0, ptlen }, pt);
 }
-void test_ofb (YAML::Node node) {
-	std::vector<uint8_t> ct = str2vec(node["ct"].as<std::string>().c_str());
-	std::vector<uint8_t> pt = str2vec(node["pt"].as<std::string>().c_str());
-	std::vector<uint8_t> iv = str2vec(node["iv"].as<std::string>().c_str());
-	std::vector<uint8_t> key = str2vec(node["key"].as<std::string>().c_str());
+void test_ofb (const test_vector &node) {
+	tv_bytes ct = node.bytes("ct");
+	tv_bytes pt = node.bytes("pt");
+	tv_bytes iv = node.bytes("iv");
+	tv_bytes key = node.bytes("key");
 
 	int keylen = key.size();
 	int ptlen = pt.size();
@@ -60,11 +96,11 @@ void test_ofb (YAML::Node node) {
 	cipher.decrypt(temp.data(),ct.data(),iv.data(),ptlen/16);
 	assert(temp == pt);
 }
-void test_cfb (YAML::Node node) {
-	std::vector<uint8_t> ct = str2vec(node["ct"].as<std::string>().c_str());
-	std::vector<uint8_t> pt = str2vec(node["pt"].as<std::string>().c_str());
-	std::vector<uint8_t> iv = str2vec(node["iv"].as<std::string>().c_str());
-	std::vector<uint8_t> key = str2vec(node["key"].as<std::string>().c_str());
+void test_cfb (const test_vector &node) {
+	tv_bytes ct = node.bytes("ct");
+	tv_bytes pt = node.bytes("pt");
+	tv_bytes iv = node.bytes("iv");
+	tv_bytes key = node.bytes("key");
 
 	int keylen = key.size();
 	int ptlen = pt.size();
@@ -77,11 +113,11 @@ void test_cfb (YAML::Node node) {
 	cipher.decrypt(temp.data(),ct.data(),iv.data(),ptlen/16);
 	assert(temp == pt);
 }
-void test_ctr (YAML::Node node) {
-	std::vector<uint8_t> ct = str2vec(node["ct"].as<std::string>().c_str());
-	std::vector<uint8_t> pt = str2vec(node["pt"].as<std::string>().c_str());
-	std::vector<uint8_t> iv = str2vec(node["iv"].as<std::string>().c_str());
-	std::vector<uint8_t> key = str2vec(node["key"].as<std::string>().c_str());
+void test_ctr (const test_vector &node) {
+	tv_bytes ct = node.bytes("ct");
+	tv_bytes pt = node.bytes("pt");
+	tv_bytes iv = node.bytes("iv");
+	tv_bytes key = node.bytes("key");
 
 	int keylen = key.size();
 	int ptlen = pt.size();
@@ -93,14 +129,18 @@ void test_ctr (YAML::Node node) {
 	assert(temp == ct);
 	cipher.decrypt(temp.data(),ct.data(),iv.data(),ptlen/16);
 	assert(temp == pt);
+
+	aes_job_key job_key(keylen*8, key.data());
+	check_jobs({ AES_JOB_CTR, &job_key, iv.data(), nullptr, pt.data(), nullptr, nullptr, 0, ptlen }, ct);
+	check_jobs({ AES_JOB_CTR, &job_key, iv.data(), nullptr, ct.data(), nullptr, nullptr, 0, ptlen }, pt);
 }
-void test_gcm(YAML::Node node) {
-	std::vector<uint8_t> ct = str2vec(node["ct"].as<std::string>().c_str());
-	std::vector<uint8_t> pt = str2vec(node["pt"].as<std::string>().c_str());
-	std::vector<uint8_t> aad = str2vec(node["aad"].as<std::string>().c_str());
-	std::vector<uint8_t> tag = str2vec(node["tag"].as<std::string>().c_str());
-	std::vector<uint8_t> iv = str2vec(node["iv"].as<std::string>().c_str());
-	std::vector<uint8_t> key = str2vec(node["key"].as<std::string>().c_str());
+void test_gcm(const test_vector &node) {
+	tv_bytes ct = node.bytes("ct");
+	tv_bytes pt = node.bytes("pt");
+	tv_bytes aad = node.bytes("aad");
+	tv_bytes tag = node.bytes("tag");
+	tv_bytes iv = node.bytes("iv");
+	tv_bytes key = node.bytes("key");
 
 	int keylen = key.size();
 	int ptlen = pt.size();
@@ -127,30 +167,525 @@ void test_gcm(YAML::Node node) {
 	assert (result == true);
 	assert(temp_data == pt);
 
+	// Multi threaded path with tiny chunks must match the serial one
+	aes_gcm_mt mt_cipher(keylen*8, 4, 64);
+	mt_cipher.init_keys(key.data());
+
+	mt_cipher.encryptandsign (
+		pt.data(), aad.data(), iv.data(), 
+		temp_data.data(), temp_tag.data(), aadlen, ptlen
+	);
+
+	assert(temp_data == ct);
+	assert(temp_tag == tag);
+
+	result = mt_cipher.decryptandverify (
+		temp_data.data(), aad.data(), iv.data(), 
+		ct.data(), tag.data(), aadlen, ptlen
+	);
+
+	assert (result == true);
+	assert(temp_data == pt);
+
+	// Batch API - same vector in every lane, last lane gets a bad tag on decrypt
+	const int num_pkts = GCM_BATCH_LANES + 1;
+	std::vector<uint8_t> batch_ct(num_pkts*ptlen), batch_pt(num_pkts*ptlen), batch_tag(num_pkts*16);
+	gcm_packet pkts[num_pkts];
+
+	for(int i=0; i<num_pkts; i++) {
+		std::copy(pt.begin(), pt.end(), batch_pt.begin()+i*ptlen);
+		pkts[i] = { iv.data(), aad.data(), batch_pt.data()+i*ptlen, batch_ct.data()+i*ptlen, batch_tag.data()+i*16, aadlen, ptlen, false };
+	}
+
+	cipher.encryptandsign_batch(pkts, num_pkts);
+
+	for(int i=0; i<num_pkts; i++) {
+		assert(std::equal(ct.begin(), ct.end(), batch_ct.begin()+i*ptlen));
+		assert(std::equal(tag.begin(), tag.end(), batch_tag.begin()+i*16));
+	}
+	std::fill(batch_pt.begin(), batch_pt.end(), 0);
+
+	batch_tag[(num_pkts-1)*16] ^= 0x1;
+	result = cipher.decryptandverify_batch(pkts, num_pkts);
+
+	assert(result == false);
+	for(int i=0; i<num_pkts-1; i++) {
+		assert(pkts[i].is_valid);
+		assert(std::equal(pt.begin(), pt.end(), batch_pt.begin()+i*ptlen));
+	}
+	assert(!pkts[num_pkts-1].is_valid);
+
+	// Job queue - seal completes through a callback, open through a future
+	aes_job_key job_key(keylen*8, key.data());
+	std::promise<bool> sealed;
+	job_mgr.submit({ AES_JOB_GCM_SEAL, &job_key, iv.data(), aad.data(), pt.data(), temp_data.data(), temp_tag.data(), aadlen, ptlen },
+		[&sealed] (bool ok) { sealed.set_value(ok); });
+
+	bool ok = sealed.get_future().get();
+	assert(ok);
+	assert(temp_data == ct);
+	assert(temp_tag == tag);
+
+	temp_tag.assign(tag.begin(), tag.end());
+	std::future<bool> opened = job_mgr.submit({ AES_JOB_GCM_OPEN, &job_key, iv.data(), aad.data(), ct.data(), temp_data.data(), temp_tag.data(), aadlen, ptlen });
+	ok = opened.get();
+	assert(ok);
+	assert(temp_data == pt);
+
+}
+
+void test_gmac(const test_vector &node) {
+	tv_bytes aad = node.bytes("aad");
+	tv_bytes tag = node.bytes("tag");
+	tv_bytes iv = node.bytes("iv");
+	tv_bytes key = node.bytes("key");
+
+	int keylen = key.size();
+	int aadlen = aad.size();
+	aes_gmac cipher(keylen*8);
+	cipher.init_keys(key.data());
+
+	std::vector<uint8_t> temp_tag(16,0);
+
+	cipher.sign(aad.data(), iv.data(), temp_tag.data(), aadlen);
+	assert(temp_tag == tag);
+	assert(cipher.verify(aad.data(), iv.data(), tag.data(), aadlen));
+
+	// Incremental, in uneven pieces
+	cipher.init(iv.data());
+	for(int i=0, step=1; i<aadlen; i+=step, step=step*2+1)
+		cipher.update(aad.data()+i, std::min(step, aadlen-i));
+	cipher.final(temp_tag.data());
+	assert(temp_tag == tag);
+
+	temp_tag[0] ^= 0x1;
+	assert(!cipher.verify(aad.data(), iv.data(), temp_tag.data(), aadlen));
+}
+
+void test_ocb(const test_vector &node) {
+	tv_bytes ct = node.bytes("ct");
+	tv_bytes pt = node.bytes("pt");
+	tv_bytes aad = node.bytes("aad");
+	tv_bytes tag = node.bytes("tag");
+	tv_bytes iv = node.bytes("iv");
+	tv_bytes key = node.bytes("key");
+
+	int keylen = key.size();
+	int ptlen = pt.size();
+	int aadlen = aad.size();
+	aes_ocb cipher(keylen*8, tag.size(), iv.size());
+	cipher.init_keys(key.data());
+
+	std::vector<uint8_t> temp_data(ptlen,0);
+	std::vector<uint8_t> temp_tag(tag.size(),0);
+
+	cipher.encryptandsign (
+		pt.data(), aad.data(), iv.data(), 
+		temp_data.data(), temp_tag.data(), aadlen, ptlen
+	);
+
+	assert(temp_data == ct);
+	assert(temp_tag == tag);
+
+	bool result = 	cipher.decryptandverify (
+		temp_data.data(), aad.data(), iv.data(), 
+		ct.data(), tag.data(), aadlen, ptlen
+	);
+
+	assert (result == true);
+	assert(temp_data == pt);
+
+	temp_tag[0] ^= 0x1;
+	result = 	cipher.decryptandverify (
+		temp_data.data(), aad.data(), iv.data(), 
+		ct.data(), temp_tag.data(), aadlen, ptlen
+	);
+	assert (result == false);
+}
+
+void test_ccm(const test_vector &node) {
+	tv_bytes ct = node.bytes("ct");
+	tv_bytes pt = node.bytes("pt");
+	tv_bytes aad = node.bytes("aad");
+	tv_bytes tag = node.bytes("tag");
+	tv_bytes iv = node.bytes("iv");
+	tv_bytes key = node.bytes("key");
+
+	int keylen = key.size();
+	int ptlen = pt.size();
+	int aadlen = aad.size();
+	aes_ccm cipher(keylen*8, tag.size(), iv.size());
+	cipher.init_keys(key.data());
+
+	std::vector<uint8_t> temp_data(ptlen,0);
+	std::vector<uint8_t> temp_tag(tag.size(),0);
+
+	cipher.encryptandsign (
+		pt.data(), aad.data(), iv.data(), 
+		temp_data.data(), temp_tag.data(), aadlen, ptlen
+	);
+
+	assert(temp_data == ct);
+	assert(temp_tag == tag);
+
+	bool result = 	cipher.decryptandverify (
+		temp_data.data(), aad.data(), iv.data(), 
+		ct.data(), tag.data(), aadlen, ptlen
+	);
+
+	assert (result == true);
+	assert(temp_data == pt);
+
+	temp_tag.back() ^= 0x1;
+	result = 	cipher.decryptandverify (
+		temp_data.data(), aad.data(), iv.data(), 
+		ct.data(), temp_tag.data(), aadlen, ptlen
+	);
+	assert (result == false);
+}
+
+void test_cmac(const test_vector &node) {
+	tv_bytes pt = node.bytes("pt");
+	tv_bytes tag = node.bytes("tag");
+	tv_bytes key = node.bytes("key");
+
+	int keylen = key.size();
+	int ptlen = pt.size();
+	aes_cmac cipher(keylen*8);
+	cipher.init_keys(key.data());
+
+	std::vector<uint8_t> temp_tag(16,0);
+
+	cipher.sign(pt.data(), temp_tag.data(), ptlen);
+	assert(temp_tag == tag);
+	assert(cipher.verify(pt.data(), tag.data(), ptlen));
+
+	// Incremental, in uneven pieces
+	cipher.init();
+	for(int i=0, step=1; i<ptlen; i+=step, step=step*2+1)
+		cipher.update(pt.data()+i, std::min(step, ptlen-i));
+	cipher.final(temp_tag.data());
+	assert(temp_tag == tag);
+
+	// Batch over prefixes of the message, each lane checked against one shot
+	const int num_msgs = CMAC_LANES + 3;
+	std::vector<uint8_t> batch_tag(num_msgs*16);
+	cmac_msg msgs[num_msgs];
+
+	for(int i=0; i<num_msgs; i++)
+		msgs[i] = { pt.data(), batch_tag.data()+i*16, i == 0 ? ptlen : (ptlen*i)/num_msgs };
+
+	cipher.sign_batch(msgs, num_msgs);
+
+	for(int i=0; i<num_msgs; i++) {
+		cipher.sign(pt.data(), temp_tag.data(), msgs[i].num_bytes);
+		assert(std::equal(temp_tag.begin(), temp_tag.end(), batch_tag.begin()+i*16));
+	}
+	assert(std::equal(tag.begin(), tag.end(), batch_tag.begin()));
+}
+
+// RFC 7253 Appendix A - iterative test over many nonce, aad and pt lengths
+void test_ocb_iter(const test_vector &node) {
+	int keylen = node.num("keylen");
+	int taglen = node.num("taglen");
+	tv_bytes tag = node.bytes("tag");
+
+	std::vector<uint8_t> key(keylen/8,0);
+	key.back() = taglen;
+
+	aes_ocb cipher(keylen, taglen/8);
+	cipher.init_keys(key.data());
+
+	std::vector<uint8_t> c, s(128,0), buf(128+16);
+	uint8_t nonce[12] = {0};
+
+	auto ocb_encrypt = [&] (uint32_t n, const uint8_t *a, int alen, const uint8_t *p, int plen) {
+		for(int i=0;i<4;i++)
+			nonce[11-i] = uint8_t (n >> (8*i));
+		cipher.encryptandsign(p, a, nonce, buf.data(), buf.data()+plen, alen, plen);
+		c.insert(c.end(), buf.begin(), buf.begin()+plen+taglen/8);
+	};
+
+	for(int i=0;i<128;i++) {
+		ocb_encrypt(3*i+1, s.data(), i, s.data(), i);
+		ocb_encrypt(3*i+2, nullptr, 0, s.data(), i);
+		ocb_encrypt(3*i+3, s.data(), i, nullptr, 0);
+	}
+
+	std::vector<uint8_t> temp_tag(taglen/8);
+	for(int i=0;i<4;i++)
+		nonce[11-i] = uint8_t (385 >> (8*i));
+	cipher.encryptandsign(nullptr, c.data(), nonce, nullptr, temp_tag.data(), c.size(), 0);
+
+	assert(temp_tag == tag);
+}
+
+void test_gcm_stream(const test_vector &node) {
+	tv_bytes key = node.bytes("key");
+	tv_bytes prefix = node.bytes("prefix");
+	tv_bytes pt = node.bytes("pt");
+	tv_bytes sealed = node.bytes("sealed");
+	int chunk_bytes = node.num("chunk");
+
+	int keylen = key.size();
+	int ptlen = pt.size();
+
+	aes_gcm_stream cipher(keylen*8, chunk_bytes, 4);
+	cipher.init_keys(key.data());
+
+	std::vector<uint8_t> temp(cipher.sealed_bytes(ptlen));
+	cipher.seal(pt.data(), ptlen, prefix.data(), temp.data());
+	assert(temp == sealed);
+
+	std::vector<uint8_t> temp_pt(ptlen,0);
+	assert(cipher.open(temp_pt.data(), sealed.data(), sealed.size()));
+	assert(temp_pt == pt);
+
+	// Every chunk and the range without the first and last chunk on their own
+	gcm_stream_header h;
+	bool header_ok = h.read(sealed.data());
+	assert(header_ok);
+	uint64_t num_chunks = h.num_chunks();
+
+	for(uint64_t c=0; c<num_chunks; c++) {
+		std::fill(temp_pt.begin(), temp_pt.end(), 0);
+		assert(cipher.open_chunks(temp_pt.data(), sealed.data(), sealed.data()+h.chunk_offset(c), c, 1));
+		assert(std::equal(temp_pt.begin(), temp_pt.begin()+h.chunk_pt_bytes(c), pt.begin()+c*chunk_bytes));
+	}
+
+	if (num_chunks > 2) {
+		assert(cipher.open_chunks(temp_pt.data(), sealed.data(), sealed.data()+h.chunk_offset(1), 1, num_chunks-2));
+		assert(std::equal(temp_pt.begin(), temp_pt.begin()+(num_chunks-2)*chunk_bytes, pt.begin()+chunk_bytes));
+	}
+
+	// Tampered chunk, truncated container, swapped chunks and a modified header must fail
+	temp.assign(sealed.begin(), sealed.end());
+	temp[h.chunk_offset(num_chunks-1)] ^= 0x1;
+	assert(!cipher.open(temp_pt.data(), temp.data(), temp.size()));
+
+	assert(!cipher.open(temp_pt.data(), sealed.data(), sealed.size()-1));
+
+	if (num_chunks > 2) {
+		temp.assign(sealed.begin(), sealed.end());
+		std::swap_ranges(temp.begin()+h.chunk_offset(0), temp.begin()+h.chunk_offset(1), temp.begin()+h.chunk_offset(1));
+		assert(!cipher.open(temp_pt.data(), temp.data(), temp.size()));
+	}
+
+	temp.assign(sealed.begin(), sealed.end());
+	temp[20] ^= 0x1;
+	assert(!cipher.open(temp_pt.data(), temp.data(), temp.size()));
+}
+
+void test_ctr_drbg(const test_vector &node) {
+	tv_bytes entropy = node.bytes("entropy");
+	tv_bytes pers = node.bytes("pers");
+	tv_bytes entropy_reseed = node.bytes("entropy_reseed");
+	tv_bytes add_reseed = node.bytes("add_reseed");
+	tv_bytes add1 = node.bytes("add1");
+	tv_bytes add2 = node.bytes("add2");
+	tv_bytes out = node.bytes("out");
+
+	ctr_drbg drbg(entropy.data(), pers.empty() ? nullptr : pers.data());
+	if (!entropy_reseed.empty())
+		drbg.reseed(entropy_reseed.data(), add_reseed.empty() ? nullptr : add_reseed.data());
+
+	std::vector<uint8_t> temp(out.size(),0);
+	drbg.generate(temp.data(), temp.size(), add1.empty() ? nullptr : add1.data());
+	drbg.generate(temp.data(), temp.size(), add2.empty() ? nullptr : add2.data());
+	assert(temp == out);
+
+	// Buffered output is the start of one full buffer request
+	ctr_drbg a(entropy.data()), b(entropy.data());
+	std::vector<uint8_t> buffered(100), direct(CTR_DRBG_BUFFER_BYTES);
+	a.fill(buffered.data(), buffered.size());
+	b.generate(direct.data(), direct.size());
+	assert(std::equal(buffered.begin(), buffered.end(), direct.begin()));
+}
+
+// Only meaningful with LAZY_CRYPTO_INSTRUMENT, counts from a worker thread are summed in too
+void test_instrument() {
+	if (!instrument::enabled())
+		return;
+
+	uint8_t key[16] = {0}, iv[16] = {0}, data[4*16] = {0}, tag[16];
+	instrument::reset();
+
+	aes_ecb ecb(AES128);
+	ecb.init_keys(key);
+	ecb.encrypt(data, data, 4);
+
+	std::thread([&] {
+		aes_gcm gcm(AES128);
+		gcm.init_keys(key);
+		gcm.encryptandsign(data, data, iv, data, tag, 16, 4*16);
+	}).join();
+
+	instr_snapshot s = instrument::snapshot();
+	assert(s.ops[INSTR_KEY_SCHEDULE].calls == 2);
+	assert(s.ops[INSTR_ENCRYPT_BLOCK].calls == 4 + 1 + 1 + 4);	// ECB, H, E(J0), CTR blocks
+	assert(s.ops[INSTR_INCR_CNTR].units == 1 + 4);
+	assert(s.ops[INSTR_GHASH_MULT].calls == 1 + 4 + 1);		// aad, ct, lengths
+
+	if (instrument::cycles_enabled()) {
+		uint64_t total = 0;
+		for(auto h : s.ops[INSTR_ENCRYPT_BLOCK].hist)
+			total += h;
+		assert(total == s.ops[INSTR_ENCRYPT_BLOCK].calls);
+	}
+
+	instrument::reset();
+	s = instrument::snapshot();
+	assert(s.ops[INSTR_ENCRYPT_BLOCK].calls == 0);
+}
+
+// SIMD blocks and scalar tail against a byte at a time encode, bad chars in both parts
+void test_hex() {
+	for(int n=0; n<70; n++) {
+		std::vector<uint8_t> in(n), out(n);
+		std::string expected;
+		for(int i=0; i<n; i++) {
+			in[i] = i*29+n;
+			expected += "0123456789abcdef"[in[i] >> 4];
+			expected += "0123456789abcdef"[in[i] & 0xf];
+		}
+
+		std::string hex = hex_encode(in.data(), n);
+		assert(hex == expected);
+		assert(hex_decode(out.data(), hex) && out == in);
+
+		std::transform(hex.begin(), hex.end(), hex.begin(), ::toupper);
+		assert(hex_decode(out.data(), hex) && out == in);
+
+		for(int i=0; i<2*n; i+=7) {
+			for(char bad : {'g', '/', ':', '@', 'G', '`', ' ', char (0x80 | hex[i])}) {
+				std::string temp = hex;
+				temp[i] = bad;
+				assert(!hex_decode(out.data(), temp));
+			}
+		}
+	}
+
+	uint8_t out[2];
+	assert(!hex_decode(out, "abc"));
+}
+
+// Table and PSHUFB kernels against the bit serial multiply
+void test_gf2_8_buf() {
+	for(int a=0; a<256; a++) {
+		for(int b=0; b<256; b++)
+			assert(gf2_8_math::mul(a,b) == gf2_8_math::ff_mult(a,b));
+		if (a)
+			assert(gf2_8_math::mul(a, gf2_8_math::inv(a)) == 1);
+	}
+
+	const int n = 1000+7;
+	std::vector<uint8_t> src(n), acc(n), expected(n), temp(n);
+	for(int i=0; i<n; i++) {
+		src[i] = i*7+3;
+		acc[i] = i*13+1;
+	}
+
+	for(int c : {0, 1, 2, 0x53, 0xff}) {
+		for(int i=0; i<n; i++)
+			expected[i] = acc[i] ^ gf2_8_math::ff_mult(c, src[i]);
+
+		temp = acc;
+		gf2_8_math::mul_acc_buf(temp.data(), src.data(), c, n);
+		assert(temp == expected);
+
+		temp = acc;
+		gf2_8_math::mul_acc_buf_scalar(temp.data(), src.data(), c, n);
+		assert(temp == expected);
+
+		temp = src;
+		gf2_8_math::mul_buf(temp.data(), temp.data(), c, n);
+		for(int i=0; i<n; i++)
+			assert(temp[i] == gf2_8_math::ff_mult(c, src[i]));
+	}
+}
+
+// 3 of 5 - every 3 share subset recovers the secret, 2 shares don't
+void test_shamir() {
+	const int n = 1000+7, num_shares = 5, threshold = 3;
+	std::vector<uint8_t> secret(n), out(n);
+	std::vector<std::vector<uint8_t>> shares(num_shares, std::vector<uint8_t>(n));
+	uint8_t *share_ptrs[num_shares];
+
+	for(int i=0; i<n; i++)
+		secret[i] = i*31+5;
+	for(int i=0; i<num_shares; i++)
+		share_ptrs[i] = shares[i].data();
+
+	shamir::split(secret.data(), n, threshold, num_shares, share_ptrs);
+
+	for(int a=0; a<num_shares; a++)
+		for(int b=a+1; b<num_shares; b++)
+			for(int c=b+1; c<num_shares; c++) {
+				uint8_t xs[3] = { uint8_t (a+1), uint8_t (b+1), uint8_t (c+1) };
+				const uint8_t *sel[3] = { share_ptrs[a], share_ptrs[b], share_ptrs[c] };
+				shamir::combine(out.data(), n, xs, sel, 3);
+				assert(out == secret);
+			}
+
+	uint8_t xs[2] = { 1, 2 };
+	shamir::combine(out.data(), n, xs, share_ptrs, 2);
+	assert(out != secret);
 }
 
 int main (int argc, char * argv[]) {
 
-	YAML::Node root = YAML::LoadFile(argv[1]);
+	test_vector_file vectors(argv[1]);
+
+	test_instrument();
+	test_hex();
+	test_gf2_8_buf();
+	test_shamir();
+
+	// Binary corpora can hold millions of vectors, only those get a per mode summary
+	std::map<std::string, long> mode_count;
+	auto start = std::chrono::steady_clock::now();
+
+	for(size_t test_count = 0; test_count < vectors.size(); test_count++) {
+		test_vector node = vectors[test_count];
+		std::string mode = node.mode();
+		if (!vectors.is_binary())
+			std::cout << "Executing Test # " << test_count << std::endl;
+		mode_count[mode]++;
 
-	int test_count = 0;
-	for(YAML::const_iterator it = root.begin(); it != root.end(); it++) {
-		std::string mode = (*it)["Mode"].as<std::string>();
-		std::cout << "Executing Test # " << test_count++ << std::endl;
 		if (mode == "AES_ECB")
-			test_ecb(*it);
+			test_ecb(node);
 		else if (mode == "AES_CBC")
-			test_cbc(*it);
+			test_cbc(node);
 		else if (mode == "AES_CFB")
-			test_cfb(*it);
+			test_cfb(node);
 		else if (mode == "AES_OFB")
-			test_ofb(*it);
+			test_ofb(node);
 		else if (mode == "AES_GCM")
-			test_gcm(*it);
+			test_gcm(node);
 		else if (mode == "AES_CTR")
-			test_ctr(*it);
+			test_ctr(node);
+		else if (mode == "AES_GMAC")
+			test_gmac(node);
+		else if (mode == "AES_OCB")
+			test_ocb(node);
+		else if (mode == "AES_OCB_ITER")
+			test_ocb_iter(node);
+		else if (mode == "AES_CCM")
+			test_ccm(node);
+		else if (mode == "AES_CMAC")
+			test_cmac(node);
+		else if (mode == "AES_GCM_STREAM")
+			test_gcm_stream(node);
+		else if (mode == "CTR_DRBG")
+			test_ctr_drbg(node);
 		else 
 			std::cout << "Unknown Mode of operation\n";
 	}
 
-}
\ No newline at end of file
+	if (vectors.is_binary()) {
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		for(auto &m : mode_count)
+			std::cout << m.first << " : " << m.second << " vectors" << std::endl;
+		std::cout << vectors.size() << " vectors in " << elapsed << " s" << std::endl;
+	}
+}
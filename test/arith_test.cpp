@@ -1,7 +1,12 @@
 #include "arith.h"
-#include "yaml-cpp/yaml.h"
+#include "limb64.h"
+#include "limb_pool.h"
+#include "test_vectors.h"
 #include "common_utils.h"
 #include <ctime>
+#include <thread>
+#include <atomic>
+#include <new>
 
 std::clock_t c0,c1;
 
@@ -12,18 +17,64 @@ std::cout << __FILE__ << ":" << __LINE__ <<" : CPU time used: " << long (1000.0
 
 #define RADIX 1024
 
+// Every heap allocation in the process goes through here so tests can count them
+static std::atomic<long> num_allocs{0}, num_alloc_bytes{0};
+
+void *operator new (size_t n) {
+	num_allocs++;
+	num_alloc_bytes += n;
+	if(void *p = std::malloc(n))
+		return p;
+	throw std::bad_alloc();
+}
+
+void operator delete (void *p) noexcept { std::free(p); }
+void operator delete (void *p, size_t) noexcept { std::free(p); }
+
+// Long division, a = q*m + r with r < m
 void test_mod() {
-	for(int i=64; i<= 3072; i=i*2){
+	for(int i=64; i<= 16384; i=i*2){
 		bigInt a(i/32),m(i/64);
 		a.randInit(); m.randInit();
 		std::cout << "Radix is " << i  << " bits " << std::endl;
+
+		bigInt q, r;
 		TICK
-		a.mod(m);
+		a.divmod(m, q, r);
 		TOCK
+		assert(q*m + r == a);
+		assert(r < m);
+
+		bigInt a_mod = a;
+		a_mod.mod(m);
+		assert(a_mod == r);
 	}
+
+	bigInt small(2), m(4);
+	small.randInit(); m.randInit();
+	bigInt q, r;
+	small.divmod(m, q, r);
+	assert(q.isZero() && r == small);
+
+	// randInit clears the top bit, a modulus using all of its top word needs the
+	// remainder's sign word kept. Both expmod paths have to agree on it
+	bigInt a(20), n(11), x(11), e(11);
+	a.randInit(); n.randInit(); x.randInit(); e.randInit();
+	n.data[9] |= 0x80000000;
+	n.data[10] = 0;
+	n.data[0] |= 1;
+
+	bigInt a_mod = a;
+	a_mod.mod(n);
+	a.divmod(n, q, r);
+	assert(!a_mod.getSign() && a_mod == r && r < n);
+
+	x.mod(n);
+	bigInt y = x.expmod(e, n, false);
+	assert(!y.getSign() && y == x.expmod(e, n, true));
 }
 
-std::vector<uint32_t> adapter(std::vector<uint8_t> in) {
+std::vector<uint32_t> adapter(tv_bytes in) {
 	std::vector<uint32_t> out;
 
 	for(int i=in.size()-1; i >= 0; i-=4) {
@@ -37,31 +88,256 @@ std::vector<uint32_t> adapter(std::vector<uint8_t> in) {
 	return out;
 }
 
-void test_expmodm (YAML::Node node) {
-	int radix = node["radix"].as<int>();
-	std::vector<uint32_t> X = adapter(str2vec(node["x"].as<std::string>().c_str()));
-	std::vector<uint32_t> A = adapter(str2vec(node["a"].as<std::string>().c_str()));
-	std::vector<uint32_t> M = adapter(str2vec(node["m"].as<std::string>().c_str()));
-	std::vector<uint32_t> Y = adapter(str2vec(node["y"].as<std::string>().c_str()));
+const char *mode_names[] = {"binary", "sliding window", "fixed window"};
+const expmod_mode modes[] = {expmod_mode::binary, expmod_mode::sliding_window, expmod_mode::fixed_window};
+
+// Fixed width path, no heap allocation inside expmod. Every mode at the default width, windows also at a small width
+template <int Bits>
+void test_expmodn (const bigInt &x, const bigInt &a, const bigInt &m, const bigInt &y) {
+	bigIntN<Bits> xn(x), an(a), mn(m);
+
+	for(int i=0; i<3; i++) {
+		std::cout << "Testing Exp mod M (bigIntN<" << Bits << ">, " << mode_names[i] << ")" << std::endl;
+		TICK
+		bigIntN<Bits> calc_y = xn.expmod(an, mn, modes[i]);
+		TOCK
+		assert(calc_y.toBigInt() == y);
+		assert(calc_y == bigIntN<Bits>(y));
+
+		assert(xn.expmod(an, mn, modes[i], 2) == calc_y);
+	}
+}
+
+void test_expmodm (const test_vector &node) {
+	int radix = node.num("radix");
+	std::vector<uint32_t> X = adapter(node.bytes("x"));
+	std::vector<uint32_t> A = adapter(node.bytes("a"));
+	std::vector<uint32_t> M = adapter(node.bytes("m"));
+	std::vector<uint32_t> Y = adapter(node.bytes("y"));
 
 	bigInt x(X.data(), radix/32);
 	bigInt a(A.data(), radix/32);
 	bigInt m(M.data(), radix/32);
 	bigInt y(Y.data(), radix/32);
 
-	std::cout << "Testing Exp mod M" << std::endl;
-	TICK
-	bigInt calc_y = x.expmod(a,m,true);
-	TOCK
-	assert(calc_y == y);
+	for(int i=0; i<3; i++) {
+		std::cout << "Testing Exp mod M (" << mode_names[i] << ")" << std::endl;
+		TICK
+		bigInt calc_y = x.expmod(a,m,true,modes[i]);
+		TOCK
+		assert(calc_y == y);
+	}
+
+	switch (radix) {
+		case 1024: test_expmodn<1024>(x, a, m, y); break;
+		case 2048: test_expmodn<2048>(x, a, m, y); break;
+		case 3072: test_expmodn<3072>(x, a, m, y); break;
+		case 4096: test_expmodn<4096>(x, a, m, y); break;
+		case 8192: test_expmodn<8192>(x, a, m, y); break;
+	}
+}
+// randInit draws from the CTR_DRBG, values must be positive and not repeat
+void test_rand() {
+	bigInt a(RADIX/32), b(RADIX/32);
+	a.randInit(); b.randInit();
+
+	assert(!a.getSign() && !b.getSign());
+	assert(!(a == b));
+}
+
+// 64 bit limb product against the 32 bit schoolbook. Odd word counts exercise the padding,
+// the larger sizes go through Karatsuba, Toom-3 and the unbalanced slicing. Same for squaring
+void test_limb64() {
+	const int sizes[] = {1, 17, 63, 64, 101, 199, 257, 420, 777};
+	for(int nx : sizes) {
+		for(int ny : sizes) {
+			bigInt x(nx), y(ny);
+			x.randInit(); y.randInit();
+			assert(x.mul(y) == x.mulPartial(y, nx + ny + 1));
+		}
+
+		bigInt x(nx);
+		x.randInit();
+		assert(x.sqr() == x.mulPartial(x, 2*nx + 1));
+	}
 }
+
+// Montgomery multiply / square against a*b mod m, odd word counts leave the top limb half used
+void test_montmult() {
+	for(int nw : {1, 3, 33, 64}) {
+		bigInt m(nw), a(nw+1), b(nw);
+		m.randInit(); a.randInit(); b.randInit();
+		m.data[0] |= 1;
+		b.mod(m);
+
+		montMult mm(m);
+		bigInt am = a, bm = b, c, s;
+		mm.zn2mont(am);
+		mm.zn2mont(bm);
+		mm.mmult(c, am, bm);
+		mm.msqr(s, am);
+		mm.mont2zn(c);
+		mm.mont2zn(s);
+
+		bigInt ab = a*b, aa = a.sqr();
+		ab.mod(m);
+		aa.mod(m);
+		assert(c == ab);
+		assert(s == aa);
+	}
+}
+
+// Cached contexts are shared per modulus and evicted least recently used first,
+// one context serves several threads at once
+void test_mont_ctx() {
+	bigInt m1(32), m2(32), x(32), e(32);
+	m1.randInit(); m2.randInit(); x.randInit(); e.randInit();
+	m1.data[0] |= 1; m2.data[0] |= 1;
+	x.mod(m1);
+
+	auto c1 = montCtx::cached(m1);
+	assert(montCtx::cached(m1) == c1);
+
+	montCtx::set_cache_size(1);
+	auto c2 = montCtx::cached(m2);
+	assert(montCtx::cached(m1) != c1);
+	montCtx::set_cache_size(MONT_CTX_CACHE_SIZE);
+
+	bigInt y = x.expmod(e, m1, true);
+	assert(x.expmod(e, *c1, expmod_mode::sliding_window) == y);
+
+	std::vector<std::thread> threads;
+	std::vector<int> ok(4, 0);
+	for(int t=0; t<4; t++)
+		threads.emplace_back([&, t] { ok[t] = (x.expmod(e, *c1) == y); });
+	for(auto &t : threads)
+		t.join();
+	for(int t : ok)
+		assert(t);
+
+	bigIntN<1024> xn(x), en(e), mn(m1);
+	montMultN<1024> mm(mn);
+	assert(xn.expmod(en, mm) == bigIntN<1024>(y));
+
+	// A modulus narrower than the fixed width leaves the top limbs of m zero
+	bigInt m3(16), x3(16);
+	m3.randInit(); x3.randInit();
+	m3.data[0] |= 1;
+	x3.mod(m3);
+	bigInt y3 = x3.expmod(e, m3, true);
+	assert(bigIntN<1024>(x3).expmod(en, bigIntN<1024>(m3)) == bigIntN<1024>(y3));
+	assert(bigIntN<2048>(x3).expmod(bigIntN<2048>(e), bigIntN<2048>(m3)) == bigIntN<2048>(y3));
+}
+
+// Montgomery expmod allocates per call (context, scratch, window table), never per multiply.
+// The fixed width path doesn't allocate at all
+void test_allocs() {
+	bigInt m(64), x(64), e(64);
+	m.randInit(); x.randInit(); e.randInit();
+	m.data[0] |= 1;
+	x.mod(m);
+	bigInt y = x.expmod(e, m, true);
+
+	for(int i=0; i<3; i++) {
+		long before = num_allocs;
+		bigInt calc_y = x.expmod(e, m, true, modes[i]);
+		long allocs = num_allocs - before;
+		assert(calc_y == y);
+		std::cout << "Allocations per 2048 bit expmod (" << mode_names[i] << ") : " << allocs << std::endl;
+		assert(allocs < 100);
+	}
+
+	bigIntN<2048> xn(x), en(e), mn(m);
+	long before = num_allocs;
+	bigIntN<2048> yn = xn.expmod(en, mn);
+	assert(num_allocs == before);
+	assert(yn == bigIntN<2048>(y));
+
+	// Temporaries are reused by the rvalue operators, compound assignment works in place
+	before = num_allocs;
+	bigInt t = x*e + m - x;
+	t += m;
+	t -= x;
+	assert(num_allocs - before <= 4);
+}
+
+// Inside a pool scope, or with the pool on globally, repeated expmods recycle their buffers
+// and stay off the global heap entirely once the free lists are warm. Leaving the scope
+// releases the lists, and with the pool off buffers aren't rounded up to a size class
+void test_limb_pool() {
+	bigInt m(64), x(64), e(64);
+	m.randInit(); x.randInit(); e.randInit();
+	m.data[0] |= 1;
+	x.mod(m);
+	bigInt y = x.expmod(e, m, true);
+
+	{
+		limb_pool::scope pool;
+		assert(limb_pool::enabled());
+
+		for(int round=0; round<2; round++) {
+			long before = num_allocs;
+			for(int i=0; i<3; i++) {
+				bigInt calc_y = x.expmod(e, m, true, modes[i]);
+				assert(calc_y == y);
+			}
+			bigInt calc_y = x.expmod(e, m, false);
+			assert(calc_y == y);
+
+			std::cout << "Heap allocations in pool scope (round " << round << ") : " << num_allocs - before << std::endl;
+			if(round == 1)
+				assert(num_allocs == before);
+		}
+	}
+	assert(!limb_pool::enabled());
+
+	long before = num_alloc_bytes;
+	bigInt v(65);
+	assert(num_alloc_bytes - before < 65*4 + 64);
+
+	{
+		limb_pool::scope pool;
+		before = num_allocs;
+		bigInt calc_y = x.expmod(e, m, true);
+		assert(calc_y == y);
+		assert(num_allocs > before);
+	}
+
+	// Buffers from another thread's pool can be released on this one
+	bigInt z;
+	std::thread([&] { limb_pool::scope pool; z = x.expmod(e, m, true); }).join();
+	assert(z == y);
+
+	limb_pool::set_enabled(true);
+	for(int round=0; round<2; round++) {
+		before = num_allocs;
+		bigInt calc_y = x.expmod(e, m, true);
+		assert(calc_y == y);
+	}
+	assert(num_allocs == before);
+	limb_pool::set_enabled(false);
+}
+
 int main (int argc, char * argv[]) {
 
-	YAML::Node root = YAML::LoadFile(argv[1]);
+	test_vector_file vectors(argv[1]);
 	
-	int test_count = 0;
-	for(YAML::const_iterator it = root.begin(); it != root.end(); it++) {		
-		test_expmodm(*it);
+	test_rand();
+	test_mod();
+	test_montmult();
+	test_mont_ctx();
+	test_allocs();
+	test_limb_pool();
+
+	// Generic __int128 kernels and, when the CPU has them, the MULX/ADX ones
+	for(bool generic : {true, false}) {
+		limb64::force_generic(generic);
+		std::cout << "limb64 kernels : " << limb64::impl() << std::endl;
+
+		test_limb64();
+		for(size_t i = 0; i < vectors.size(); i++) {		
+			test_expmodm(vectors[i]);
+		}
 	}
 
 }
\ No newline at end of file
@@ -0,0 +1,70 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "aes_block_cipher.h"
+
+// Seal throughput (MB/s) of the AEAD modes on the same key sizes and message sizes
+
+#define AAD_BYTES 	16
+#define MIN_SECONDS 0.5
+
+typedef std::chrono::steady_clock bench_clock;
+
+template <typename F>
+double mb_per_sec (F run_once, int msg_bytes) {
+	long num_bytes = 0;
+	auto start = bench_clock::now();
+	double elapsed = 0;
+
+	do {
+		run_once();
+		num_bytes += msg_bytes;
+		elapsed = std::chrono::duration<double>(bench_clock::now() - start).count();
+	} while (elapsed < MIN_SECONDS);
+
+	return num_bytes / elapsed / 1e6;
+}
+
+int main (int argc, char * argv[]) {
+
+	uint8_t key[32], iv[12], aad[AAD_BYTES], tag[16];
+	for(auto &b : key) b = rand();
+	for(auto &b : iv)  b = rand();
+	for(auto &b : aad) b = rand();
+
+	std::cout << "key_size msg_bytes     gcm_MBps     ocb_MBps     ccm_MBps" << std::endl;
+
+	for(int key_size : {AES128, AES192, AES256}) {
+		aes_gcm gcm(key_size);
+		aes_ocb ocb(key_size);
+		aes_ccm ccm(key_size);
+		gcm.init_keys(key);
+		ocb.init_keys(key);
+		ccm.init_keys(key);
+
+		for(int msg_bytes : {64, 1024, 16384}) {
+			std::vector<uint8_t> pt(msg_bytes), ct(msg_bytes);
+			for(auto &b : pt) b = rand();
+
+			double gcm_rate = mb_per_sec([&] {
+				gcm.encryptandsign(pt.data(), aad, iv, ct.data(), tag, AAD_BYTES, msg_bytes);
+			}, msg_bytes);
+
+			double ocb_rate = mb_per_sec([&] {
+				ocb.encryptandsign(pt.data(), aad, iv, ct.data(), tag, AAD_BYTES, msg_bytes);
+			}, msg_bytes);
+
+			double ccm_rate = mb_per_sec([&] {
+				ccm.encryptandsign(pt.data(), aad, iv, ct.data(), tag, AAD_BYTES, msg_bytes);
+			}, msg_bytes);
+
+			std::cout << std::setw(8) << key_size << std::setw(10) << msg_bytes
+					  << std::fixed << std::setprecision(2)
+					  << std::setw(13) << gcm_rate << std::setw(13) << ocb_rate << std::setw(13) << ccm_rate << std::endl;
+		}
+	}
+}
@@ -0,0 +1,205 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#else
+#define HAVE_TSC 0
+#endif
+
+#include "aes_block_cipher.h"
+
+/****************************************************************
+	AES benchmark - cycles/byte and latency percentiles for
+	every mode, key size and message sizes 16 B .. 64 MB.
+
+	bench_aes [--cpu N] [--min-bytes N] [--max-bytes N]
+	          [--min-time S] [--json FILE]
+
+	Each (mode, key, size) point is warmed up once, then timed
+	for at least --min-time seconds and 3 calls. Cycles are TSC
+	ticks (ns where there is no TSC), results go out as JSON.
+****************************************************************/
+
+typedef std::chrono::steady_clock bench_clock;
+
+struct bench_opts {
+	int 	cpu 		= 0;
+	size_t 	min_bytes 	= 16;
+	size_t 	max_bytes 	= 64 << 20;
+	double 	min_time 	= 0.2;
+	std::string json;
+};
+
+struct bench_point {
+	std::string mode;
+	int 	key_bits;
+	size_t 	bytes;
+	size_t 	reps;
+	double 	cycles_per_byte, mb_per_sec;
+	double 	ns_min, ns_p50, ns_p90, ns_p99;
+};
+
+static uint64_t ticks () {
+#if HAVE_TSC
+	return __rdtsc();
+#else
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(bench_clock::now().time_since_epoch()).count();
+#endif
+}
+
+static void pin_to_cpu (int cpu) {
+#ifdef __linux__
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (sched_setaffinity(0, sizeof(set), &set) != 0)
+		std::cerr << "Could not pin to cpu " << cpu << std::endl;
+#endif
+}
+
+static double percentile (std::vector<double> &v, double p) {
+	return v[std::min(v.size()-1, size_t (p*v.size()))];
+}
+
+static bench_point measure (const std::string &mode, int key_bits, size_t bytes, double min_time, const std::function<void()> &op) {
+	op();	// warm up caches, tables and the branch predictor
+
+	std::vector<double> ns;
+	std::vector<uint64_t> cyc;
+	auto start = bench_clock::now();
+
+	do {
+		auto t0 = bench_clock::now();
+		uint64_t c0 = ticks();
+		op();
+		uint64_t c1 = ticks();
+		auto t1 = bench_clock::now();
+
+		ns.push_back(std::chrono::duration<double, std::nano>(t1 - t0).count());
+		cyc.push_back(c1 - c0);
+	} while (ns.size() < 3 || std::chrono::duration<double>(bench_clock::now() - start).count() < min_time);
+
+	std::sort(ns.begin(), ns.end());
+	std::sort(cyc.begin(), cyc.end());
+
+	bench_point p;
+	p.mode 				= mode;
+	p.key_bits 			= key_bits;
+	p.bytes 			= bytes;
+	p.reps 				= ns.size();
+	p.cycles_per_byte 	= double (cyc[cyc.size()/2]) / bytes;
+	p.ns_min 			= ns.front();
+	p.ns_p50 			= percentile(ns, 0.50);
+	p.ns_p90 			= percentile(ns, 0.90);
+	p.ns_p99 			= percentile(ns, 0.99);
+	p.mb_per_sec 		= bytes / p.ns_p50 * 1e3;
+	return p;
+}
+
+static std::string to_json (const std::vector<bench_point> &points, const bench_opts &opts) {
+	std::ostringstream js;
+	js << "{\n  \"backend\": \"aes_block_cipher\",\n"
+	   << "  \"cycle_source\": \"" << (HAVE_TSC ? "tsc" : "ns") << "\",\n"
+	   << "  \"cpu\": " << opts.cpu << ",\n"
+	   << "  \"results\": [\n";
+
+	for(size_t i=0; i<points.size(); i++) {
+		const bench_point &p = points[i];
+		js << "    {\"mode\": \"" << p.mode << "\", \"key_bits\": " << p.key_bits
+		   << ", \"bytes\": " << p.bytes << ", \"reps\": " << p.reps
+		   << ", \"cycles_per_byte\": " << p.cycles_per_byte << ", \"mb_per_sec\": " << p.mb_per_sec
+		   << ", \"ns_min\": " << p.ns_min << ", \"ns_p50\": " << p.ns_p50
+		   << ", \"ns_p90\": " << p.ns_p90 << ", \"ns_p99\": " << p.ns_p99 << "}"
+		   << (i+1 < points.size() ? ",\n" : "\n");
+	}
+
+	js << "  ]\n}\n";
+	return js.str();
+}
+
+int main (int argc, char * argv[]) {
+
+	bench_opts opts;
+	for(int i=1; i+1<argc; i+=2) {
+		std::string opt = argv[i];
+		if (opt == "--cpu")
+			opts.cpu = atoi(argv[i+1]);
+		else if (opt == "--min-bytes")
+			opts.min_bytes = strtoull(argv[i+1], nullptr, 0);
+		else if (opt == "--max-bytes")
+			opts.max_bytes = strtoull(argv[i+1], nullptr, 0);
+		else if (opt == "--min-time")
+			opts.min_time = atof(argv[i+1]);
+		else if (opt == "--json")
+			opts.json = argv[i+1];
+		else {
+			std::cout << "Unknown option " << opt << std::endl;
+			std::exit(1);
+		}
+	}
+
+	pin_to_cpu(opts.cpu);
+
+	std::vector<bench_point> points;
+	uint8_t key[32], iv[16], aad[16];
+	for(auto &b : key) b = rand();
+	for(auto &b : iv)  b = rand();
+	for(auto &b : aad) b = rand();
+
+	for(int key_bits : {AES128, AES192, AES256}) {
+		aes_ecb ecb(key_bits);	ecb.init_keys(key);
+		aes_cbc cbc(key_bits);	cbc.init_keys(key);
+		aes_cfb cfb(key_bits);	cfb.init_keys(key);
+		aes_ofb ofb(key_bits);	ofb.init_keys(key);
+		aes_ctr ctr(key_bits);	ctr.init_keys(key);
+		aes_gcm gcm(key_bits);	gcm.init_keys(key);
+
+		for(size_t bytes = opts.min_bytes; bytes <= opts.max_bytes; bytes *= 4) {
+			std::vector<uint8_t> pt(bytes), ct(bytes), out(bytes);
+			for(auto &b : pt) b = rand();
+			int blocks = bytes / 16;
+			uint8_t tag[16];
+
+			std::vector<std::pair<std::string, std::function<void()>>> ops = {
+				{ "ECB_enc", [&] { ecb.encrypt(pt.data(), ct.data(), blocks); } },
+				{ "ECB_dec", [&] { ecb.decrypt(out.data(), ct.data(), blocks); } },
+				{ "CBC_enc", [&] { cbc.encrypt(pt.data(), ct.data(), iv, blocks); } },
+				{ "CBC_dec", [&] { cbc.decrypt(out.data(), ct.data(), iv, blocks); } },
+				{ "CFB_enc", [&] { cfb.encrypt(pt.data(), ct.data(), iv, blocks); } },
+				{ "CFB_dec", [&] { cfb.decrypt(out.data(), ct.data(), iv, blocks); } },
+				{ "OFB", 	 [&] { ofb.encrypt(pt.data(), ct.data(), iv, blocks); } },
+				{ "CTR", 	 [&] { ctr.encrypt(pt.data(), ct.data(), iv, blocks); } },
+				{ "GCM_seal",[&] { gcm.encryptandsign(pt.data(), aad, iv, ct.data(), tag, sizeof(aad), bytes); } },
+				{ "GCM_open",[&] { gcm.decryptandverify(out.data(), aad, iv, ct.data(), tag, sizeof(aad), bytes); } },
+			};
+
+			for(auto &op : ops) {
+				points.push_back(measure(op.first, key_bits, bytes, opts.min_time, op.second));
+				const bench_point &p = points.back();
+				std::cerr << p.mode << " aes" << key_bits << " " << bytes << " B : "
+						  << p.cycles_per_byte << " cycles/B" << std::endl;
+			}
+		}
+	}
+
+	std::string js = to_json(points, opts);
+	if (opts.json.empty())
+		std::cout << js;
+	else
+		std::ofstream(opts.json) << js;
+}
@@ -0,0 +1,68 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+#include "arith.h"
+#include "instrument.h"
+
+// bigIntN expmod time and Montgomery multiplies per exponent bit, by mode and window width.
+// The multiply counts need a -DLAZY_CRYPTO_INSTRUMENT=ON build
+
+#define MIN_SECONDS 0.3
+
+typedef std::chrono::steady_clock bench_clock;
+
+template <int Bits>
+void bench (const char *name, expmod_mode mode, int window) {
+	bigInt x_(Bits/32), a_(Bits/32), m_(Bits/32);
+	x_.randInit(); a_.randInit(); m_.randInit();
+	m_.data[0] |= 1;
+	m_.data.back() |= 0x40000000;
+	x_.mod(m_);
+	bigIntN<Bits> x(x_), a(a_), m(m_);
+
+	instrument::reset();
+	long num_runs = 0;
+	auto start = bench_clock::now();
+	double elapsed = 0;
+	do {
+		x.expmod(a, m, mode, window);
+		num_runs++;
+		elapsed = std::chrono::duration<double>(bench_clock::now() - start).count();
+	} while (elapsed < MIN_SECONDS);
+
+	instr_snapshot s = instrument::snapshot();
+	double bits = (double) num_runs * a.numBits();
+	double mults = s.ops[INSTR_MONT_MULT].calls / bits;
+	double sqrs = s.ops[INSTR_MONT_SQR].calls / bits;
+
+	std::cout << std::setw(5) << Bits << std::setw(16) << name << std::setw(7) << window
+			  << std::setw(10) << elapsed / num_runs * 1e3;
+	if(instrument::enabled())
+		std::cout << std::setw(9) << mults << std::setw(8) << sqrs;
+	std::cout << std::endl;
+}
+
+template <int Bits>
+void bench_all () {
+	bench<Bits>("binary", expmod_mode::binary, 0);
+	for(int w=1; w<=EXPMOD_MAX_SLIDING; w++)
+		bench<Bits>("sliding", expmod_mode::sliding_window, w);
+	for(int w=1; w<=EXPMOD_MAX_FIXED; w++)
+		bench<Bits>("fixed", expmod_mode::fixed_window, w);
+}
+
+int main (int argc, char * argv[]) {
+
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << " bits            mode  window        ms";
+	if(instrument::enabled())
+		std::cout << "  mult/bit sqr/bit";
+	std::cout << std::endl;
+
+	bench_all<1024>();
+	bench_all<2048>();
+	bench_all<4096>();
+}
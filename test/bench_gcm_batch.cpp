@@ -0,0 +1,78 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "aes_block_cipher.h"
+
+// Packets per second for GCM seal, one call per packet vs the batch API
+
+#define NUM_PKTS 	64
+#define AAD_BYTES 	16
+#define MIN_SECONDS 0.5
+
+typedef std::chrono::steady_clock bench_clock;
+
+struct pkt_buffers {
+	std::vector<uint8_t> iv, aad, pt, ct, tag;
+	std::vector<gcm_packet> pkts;
+
+	pkt_buffers(int pkt_bytes) :
+		iv(NUM_PKTS*12), aad(NUM_PKTS*AAD_BYTES), pt(NUM_PKTS*pkt_bytes), ct(NUM_PKTS*pkt_bytes), tag(NUM_PKTS*16)
+	{
+		for(auto &b : iv)  b = rand();
+		for(auto &b : aad) b = rand();
+		for(auto &b : pt)  b = rand();
+
+		for(int i=0; i<NUM_PKTS; i++)
+			pkts.push_back({ &iv[i*12], &aad[i*AAD_BYTES], &pt[i*pkt_bytes], &ct[i*pkt_bytes], &tag[i*16], AAD_BYTES, pkt_bytes, false });
+	}
+};
+
+template <typename F>
+double pkts_per_sec (F run_once) {
+	long num_pkts = 0;
+	auto start = bench_clock::now();
+	double elapsed = 0;
+
+	do {
+		run_once();
+		num_pkts += NUM_PKTS;
+		elapsed = std::chrono::duration<double>(bench_clock::now() - start).count();
+	} while (elapsed < MIN_SECONDS);
+
+	return num_pkts / elapsed;
+}
+
+int main (int argc, char * argv[]) {
+
+	uint8_t key[32];
+	for(auto &b : key) b = rand();
+
+	std::cout << "key_size pkt_bytes    per_call_pps       batch_pps  speedup" << std::endl;
+
+	for(int key_size : {AES128, AES256}) {
+		aes_gcm cipher(key_size);
+		cipher.init_keys(key);
+
+		for(int pkt_bytes : {64, 576, 1500}) {
+			pkt_buffers buf(pkt_bytes);
+
+			double single = pkts_per_sec([&] {
+				for(auto &p : buf.pkts)
+					cipher.encryptandsign(p.pt, p.aad, p.iv, p.ct, p.tag, p.num_aad_bytes, p.num_pt_bytes);
+			});
+
+			double batch = pkts_per_sec([&] {
+				cipher.encryptandsign_batch(buf.pkts.data(), NUM_PKTS);
+			});
+
+			std::cout << std::setw(8) << key_size << std::setw(10) << pkt_bytes
+					  << std::fixed << std::setprecision(0)
+					  << std::setw(16) << single << std::setw(16) << batch
+					  << std::setprecision(2) << std::setw(9) << batch/single << std::endl;
+		}
+	}
+}
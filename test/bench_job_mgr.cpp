@@ -0,0 +1,93 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "aes_job_mgr.h"
+
+// GCM seal throughput and completion latency of the job queue under fan in from
+// several submitting threads, against one bulk call over the same number of bytes
+
+#define JOBS_PER_THREAD 2048
+#define WINDOW 			16
+#define AAD_BYTES 		16
+#define BULK_BYTES 		(1<<20)
+
+typedef std::chrono::steady_clock bench_clock;
+
+double bulk_mbps (aes_gcm &cipher) {
+	std::vector<uint8_t> pt(BULK_BYTES, 1), ct(BULK_BYTES), iv(12, 2), aad(AAD_BYTES, 3), tag(16);
+
+	auto start = bench_clock::now();
+	cipher.encryptandsign(pt.data(), aad.data(), iv.data(), ct.data(), tag.data(), AAD_BYTES, BULK_BYTES);
+	double elapsed = std::chrono::duration<double>(bench_clock::now() - start).count();
+
+	return BULK_BYTES / elapsed / 1e6;
+}
+
+// Each thread keeps WINDOW jobs in flight, latency is submit to future ready
+void producer (aes_job_mgr &mgr, aes_job_key &key, int pkt_bytes, std::vector<double> &lat_us) {
+	std::vector<uint8_t> iv(12*WINDOW), aad(AAD_BYTES, 3), pt(pkt_bytes*WINDOW), ct(pkt_bytes*WINDOW), tag(16*WINDOW);
+	for(auto &b : iv) b = rand();
+	for(auto &b : pt) b = rand();
+
+	for(int n=0; n<JOBS_PER_THREAD; n+=WINDOW) {
+		std::future<bool> res[WINDOW];
+		bench_clock::time_point t_submit[WINDOW];
+
+		for(int i=0; i<WINDOW; i++) {
+			t_submit[i] = bench_clock::now();
+			res[i] = mgr.submit({ AES_JOB_GCM_SEAL, &key, &iv[i*12], aad.data(), &pt[i*pkt_bytes], &ct[i*pkt_bytes], &tag[i*16], AAD_BYTES, pkt_bytes });
+		}
+
+		for(int i=0; i<WINDOW; i++) {
+			res[i].get();
+			lat_us.push_back(std::chrono::duration<double, std::micro>(bench_clock::now() - t_submit[i]).count());
+		}
+	}
+}
+
+int main (int argc, char * argv[]) {
+
+	uint8_t key_bytes[16];
+	for(auto &b : key_bytes) b = rand();
+
+	aes_job_key key(AES128, key_bytes);
+	aes_gcm cipher(AES128);
+	cipher.init_keys(key_bytes);
+
+	std::cout << "bulk MB/s: " << std::fixed << std::setprecision(1) << bulk_mbps(cipher) << std::endl;
+	std::cout << "threads pkt_bytes  queue_MB/s  p50_us  p99_us" << std::endl;
+
+	for(int num_threads : {1, 4, 8}) {
+		for(int pkt_bytes : {64, 576}) {
+			aes_job_mgr mgr(32, 100);
+			std::vector<std::vector<double>> lat(num_threads);
+			std::vector<std::thread> threads;
+
+			auto start = bench_clock::now();
+			for(int t=0; t<num_threads; t++)
+				threads.emplace_back(producer, std::ref(mgr), std::ref(key), pkt_bytes, std::ref(lat[t]));
+			for(auto &t : threads)
+				t.join();
+			double elapsed = std::chrono::duration<double>(bench_clock::now() - start).count();
+
+			std::vector<double> all;
+			for(auto &l : lat)
+				all.insert(all.end(), l.begin(), l.end());
+			std::sort(all.begin(), all.end());
+
+			double mbps = (double) num_threads * JOBS_PER_THREAD * pkt_bytes / elapsed / 1e6;
+
+			std::cout << std::setw(7) << num_threads << std::setw(10) << pkt_bytes
+					  << std::setprecision(1) << std::setw(12) << mbps
+					  << std::setprecision(0) << std::setw(8) << all[all.size()/2]
+					  << std::setw(8) << all[all.size()*99/100] << std::endl;
+		}
+	}
+}
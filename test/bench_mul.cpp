@@ -0,0 +1,96 @@
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "limb64.h"
+
+// Karatsuba / Toom-3 crossover search, multiply and square time by operand size
+
+#define MIN_SECONDS 0.05
+#define REPEATS 5
+
+typedef std::chrono::steady_clock bench_clock;
+
+template <typename F>
+double us_per_call (F run_once) {
+	long num_runs = 0;
+	auto start = bench_clock::now();
+	double elapsed = 0;
+
+	do {
+		run_once();
+		num_runs++;
+		elapsed = std::chrono::duration<double>(bench_clock::now() - start).count();
+	} while (elapsed < MIN_SECONDS);
+
+	return elapsed / num_runs * 1e6;
+}
+
+double time_mul (int n, bool square = false) {
+	std::vector<limb64::limb> a(n), b(n), r(2*n), scratch(limb64::mul_n_scratch(n));
+	for(int i=0; i<n; i++) {
+		a[i] = ((limb64::limb) rand() << 32) | rand();
+		b[i] = ((limb64::limb) rand() << 32) | rand();
+	}
+	// Best of a few runs, the crossover search compares near equal times
+	double best = 0;
+	for(int i=0; i<REPEATS; i++) {
+		double t = us_per_call([&] {
+			if(square)
+				limb64::sqr_n(r.data(), a.data(), n, scratch.data());
+			else
+				limb64::mul_n(r.data(), a.data(), b.data(), n, scratch.data());
+		});
+		best = (i == 0 || t < best) ? t : best;
+	}
+	return best;
+}
+
+// Smallest size from which one more level of the faster algorithm wins twice in a row
+template <typename F>
+int crossover (int from, int to, int step, F set_threshold) {
+	int wins = 0;
+	for(int n=from; n<=to; n+=step) {
+		set_threshold(n+1);
+		double below = time_mul(n);
+		set_threshold(n);
+		double above = time_mul(n);
+
+		std::cout << std::setw(6) << n << std::setw(12) << below << std::setw(12) << above << std::endl;
+		wins = (above < below) ? wins+1 : 0;
+		if(wins == 2)
+			return n - step;
+	}
+	return to;
+}
+
+int main (int argc, char * argv[]) {
+
+	std::cout << "limb64 kernels : " << limb64::impl() << std::endl;
+	std::cout << std::fixed << std::setprecision(2);
+
+	std::cout << "limbs  schoolbook_us  karatsuba_us" << std::endl;
+	int kara = crossover(8, 128, 4, [] (int t) { limb64::set_mul_thresholds(t, INT_MAX); });
+
+	std::cout << "limbs  karatsuba_us  toom3_us" << std::endl;
+	int toom = crossover(kara > 25 ? kara : 25, 512, 8, [kara] (int t) { limb64::set_mul_thresholds(kara, t); });
+
+	std::cout << "karatsuba_threshold " << kara << "  toom3_threshold " << toom << std::endl;
+
+	std::cout << "bits  schoolbook_us  tuned_us  sqr_us" << std::endl;
+	for(int bits = 1024; bits <= 16384; bits *= 2) {
+		int n = bits/64;
+		limb64::set_mul_thresholds(INT_MAX, INT_MAX);
+		double school = time_mul(n);
+		limb64::set_mul_thresholds(kara, toom);
+		double tuned = time_mul(n);
+		double sqr = time_mul(n, true);
+
+		std::cout << std::setw(5) << bits << std::setw(15) << school << std::setw(10) << tuned
+				  << std::setw(8) << sqr << std::endl;
+	}
+}
@@ -0,0 +1,75 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "common_utils.h"
+#include "shamir.h"
+
+// GF(2^8) multiply accumulate kernels and Shamir split/combine throughput by share count
+
+#define BUF_BYTES 	(64*1024)
+#define SECRET_BYTES (1<<20)
+#define MIN_SECONDS 0.5
+
+typedef std::chrono::steady_clock bench_clock;
+
+template <typename F>
+double mb_per_sec (size_t bytes_per_run, F run_once) {
+	long num_runs = 0;
+	auto start = bench_clock::now();
+	double elapsed = 0;
+
+	do {
+		run_once();
+		num_runs++;
+		elapsed = std::chrono::duration<double>(bench_clock::now() - start).count();
+	} while (elapsed < MIN_SECONDS);
+
+	return num_runs * bytes_per_run / elapsed / 1e6;
+}
+
+int main (int argc, char * argv[]) {
+
+	std::vector<uint8_t> src(BUF_BYTES), dst(BUF_BYTES);
+	for(auto &b : src) b = rand();
+
+	double scalar = mb_per_sec(BUF_BYTES, [&] {
+		gf2_8_math::mul_acc_buf_scalar(dst.data(), src.data(), 0x53, BUF_BYTES);
+	});
+	double simd = mb_per_sec(BUF_BYTES, [&] {
+		gf2_8_math::mul_acc_buf(dst.data(), src.data(), 0x53, BUF_BYTES);
+	});
+
+	std::cout << std::fixed << std::setprecision(0);
+	std::cout << "mul_acc_buf MB/s  scalar " << scalar << "  " << gf2_8_math::buf_impl() << " " << simd << std::endl;
+
+	std::cout << "threshold shares  split_MB/s  combine_MB/s" << std::setprecision(1) << std::endl;
+
+	std::vector<uint8_t> secret(SECRET_BYTES), out(SECRET_BYTES);
+	for(auto &b : secret) b = rand();
+
+	for(auto tn : { std::make_pair(2,3), std::make_pair(3,5), std::make_pair(5,10), std::make_pair(8,16) }) {
+		int threshold = tn.first, num_shares = tn.second;
+
+		std::vector<std::vector<uint8_t>> shares(num_shares, std::vector<uint8_t>(SECRET_BYTES));
+		std::vector<uint8_t *> share_ptrs;
+		std::vector<uint8_t> xs;
+		for(int i=0; i<num_shares; i++) {
+			share_ptrs.push_back(shares[i].data());
+			xs.push_back(i+1);
+		}
+
+		double split = mb_per_sec(SECRET_BYTES, [&] {
+			shamir::split(secret.data(), SECRET_BYTES, threshold, num_shares, share_ptrs.data());
+		});
+		double combine = mb_per_sec(SECRET_BYTES, [&] {
+			shamir::combine(out.data(), SECRET_BYTES, xs.data(), share_ptrs.data(), threshold);
+		});
+
+		std::cout << std::setw(9) << threshold << std::setw(7) << num_shares
+				  << std::setw(12) << split << std::setw(14) << combine << std::endl;
+	}
+}
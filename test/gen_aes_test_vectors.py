@@ -1,6 +1,8 @@
 #! /usr/bin/python3
 
 from cryptography.hazmat.primitives.ciphers import Cipher, algorithms, modes
+from cryptography.hazmat.primitives.ciphers.aead import AESOCB3, AESCCM, AESGCM
+from cryptography.hazmat.primitives.cmac import CMAC
 from cryptography.hazmat.backends import default_backend
 import os
 import sys
@@ -8,8 +10,9 @@ import yaml
 from datetime import datetime
 import binascii
 import random
+import struct
 
-def generate_xxx(cipher_mode, key_size, num_aes_blocks, yamlfile):
+def generate_xxx(cipher_mode, key_size, num_aes_blocks):
     assert(key_size in [128,192,256])
 
     iv = os.urandom(16)
@@ -45,7 +48,7 @@ def generate_xxx(cipher_mode, key_size, num_aes_blocks, yamlfile):
                     'ct'    : binascii.hexlify(ct).decode("utf-8")
                 }
 
-    yaml.dump([testvector],yamlfile,default_flow_style=False)
+    vecfile.write(testvector)
 
 def generate_gcm(key_size, ptlen, aadlen):
     assert(key_size in [128,192,256])
@@ -69,11 +72,348 @@ def generate_gcm(key_size, ptlen, aadlen):
                     'ct'    : binascii.hexlify(ct).decode("utf-8"),
                     'tag'   : binascii.hexlify(tag).decode("utf-8")
                 }
-    yaml.dump([testvector],yamlfile,default_flow_style=False)
+    vecfile.write(testvector)
+
+def generate_gmac(key_size, aadlen):
+    assert(key_size in [128,192,256])
+    key = os.urandom(key_size//8)
+    iv = os.urandom(12)
+    aad = os.urandom(aadlen)
+    alg = algorithms.AES(key)
+    mode = modes.GCM(iv)
+    cipher = Cipher(alg,mode,default_backend())
+    enc = cipher.encryptor()
+    enc.authenticate_additional_data(aad)
+    enc.finalize()
+    tag = enc.tag
+    testvector = {  'Mode'  : 'AES_GMAC',
+                    'key'   : binascii.hexlify(key).decode("utf-8"),
+                    'iv'    : binascii.hexlify(iv).decode("utf-8"),
+                    'aad'   : binascii.hexlify(aad).decode("utf-8"),
+                    'tag'   : binascii.hexlify(tag).decode("utf-8")
+                }
+    vecfile.write(testvector)
+
+def generate_ocb(key_size, ptlen, aadlen):
+    assert(key_size in [128,192,256])
+    key = os.urandom(key_size//8)
+    iv = os.urandom(12)
+    pt = os.urandom(ptlen)
+    aad = os.urandom(aadlen)
+    ct = AESOCB3(key).encrypt(iv, pt, aad)
+    testvector = {  'Mode'  : 'AES_OCB',
+                    'key'   : binascii.hexlify(key).decode("utf-8"),
+                    'iv'    : binascii.hexlify(iv).decode("utf-8"),
+                    'pt'    : binascii.hexlify(pt).decode("utf-8"),
+                    'aad'   : binascii.hexlify(aad).decode("utf-8"),
+                    'ct'    : binascii.hexlify(ct[:-16]).decode("utf-8"),
+                    'tag'   : binascii.hexlify(ct[-16:]).decode("utf-8")
+                }
+    vecfile.write(testvector)
+
+# RFC 7253 appendix A, fixed known answers kept alongside the random vectors.
+# Sample i has nonce BBAA99887766554433221100 + i, A and P are prefixes of 00 01 02 ...
+# of the listed lengths - (aad bytes, pt bytes, ciphertext, tag)
+ocb_rfc7253_samples = [
+    ( 0,  0, '', '785407bfffc8ad9edcc5520ac9111ee6'),
+    ( 8,  8, '6820b3657b6f615a', '5725bda0d3b4eb3a257c9af1f8f03009'),
+    ( 8,  0, '', '81017f8203f081277152fade694a0a00'),
+    ( 0,  8, '45dd69f8f5aae724', '14054cd1f35d82760b2cd00d2f99bfa9'),
+    (16, 16, '571d535b60b277188be5147170a9a22c', '3ad7a4ff3835b8c5701c1ccec8fc3358'),
+    (16,  0, '', '8cf761b6902ef764462ad86498ca6b97'),
+    ( 0, 16, '5ce88ec2e0692706a915c00aeb8b2396', 'f40e1c743f52436bdf06d8fa1eca343d'),
+    (24, 24, '1ca2207308c87c010756104d8840ce1952f09673a448a122', 'c92c62241051f57356d7f3c90bb0e07f'),
+    (24,  0, '', '6dc225a071fc1b9f7c69f93b0f1e10de'),
+    ( 0, 24, '221bd0de7fa6fe993eccd769460a0af2d6cded0c395b1c3c', 'e725f32494b9f914d85c0b1eb38357ff'),
+    (32, 32, 'bd6f6c496201c69296c11efd138a467abd3c707924b964deaffc40319af5a485', '40fbba186c5553c68ad9f592a79a4240'),
+    (32,  0, '', 'fe80690bee8a485d11f32965bc9d2a32'),
+    ( 0, 32, '2942bfc773bda23cabc6acfd9bfd5835bd300f0973792ef46040c53f1432bcdf', 'b5e1dde3bc18a5f840b52e653444d5df'),
+    (40, 40, 'd5ca91748410c1751ff8a2f618255b68a0a12e093ff454606e59f9c1d0ddc54b65e8628e568bad7a', 'ed07ba06a4a69483a7035490c5769e60'),
+    (40,  0, '', 'c5cd9d1850c141e358649994ee701b68'),
+    ( 0, 40, '4412923493c57d5de0d700f753cce0d1d2d95060122e9f15a5ddbfc5787e50b5cc55ee507bcb084e', '479ad363ac366b95a98ca5f3000b1479'),
+]
+
+# Final tag of the RFC 7253 iterated test for each tag length and key length
+ocb_rfc7253_iter = [
+    (128, 128, '67e944d23256c5e0b6c61fa22fdf1ea2'),
+    (128, 192, 'f673f2c3e7174aae7bae986ca9f29e17'),
+    (128, 256, 'd90eb8e9c977c88b79dd793d7ffa161c'),
+    ( 96, 128, '77a3d8e73589158d25d01209'),
+    ( 96, 192, '05d56ead2752c86be6932c5e'),
+    ( 96, 256, '5458359ac23b0cba9e6330dd'),
+    ( 64, 128, '192c9b7bd90ba06a'),
+    ( 64, 192, '0066bc6e0ef34e24'),
+    ( 64, 256, '7d4ea5d445501cbe'),
+]
+
+def write_ocb_kats():
+    key = bytes(range(16))
+    for i, (aadlen, ptlen, ct, tag) in enumerate(ocb_rfc7253_samples):
+        testvector = {  'Mode'  : 'AES_OCB',
+                        'key'   : binascii.hexlify(key).decode("utf-8"),
+                        'iv'    : 'bbaa998877665544332211%02x' % i,
+                        'pt'    : binascii.hexlify(bytes(range(ptlen))).decode("utf-8"),
+                        'aad'   : binascii.hexlify(bytes(range(aadlen))).decode("utf-8"),
+                        'ct'    : ct,
+                        'tag'   : tag
+                    }
+        vecfile.write(testvector)
+
+    for taglen, keylen, tag in ocb_rfc7253_iter:
+        vecfile.write({'Mode' : 'AES_OCB_ITER', 'keylen' : keylen, 'taglen' : taglen, 'tag' : tag})
+
+def generate_ccm(key_size, ptlen, aadlen, taglen, ivlen):
+    assert(key_size in [128,192,256])
+    key = os.urandom(key_size//8)
+    iv = os.urandom(ivlen)
+    pt = os.urandom(ptlen)
+    aad = os.urandom(aadlen)
+    ct = AESCCM(key, tag_length=taglen).encrypt(iv, pt, aad)
+    testvector = {  'Mode'  : 'AES_CCM',
+                    'key'   : binascii.hexlify(key).decode("utf-8"),
+                    'iv'    : binascii.hexlify(iv).decode("utf-8"),
+                    'pt'    : binascii.hexlify(pt).decode("utf-8"),
+                    'aad'   : binascii.hexlify(aad).decode("utf-8"),
+                    'ct'    : binascii.hexlify(ct[:-taglen]).decode("utf-8"),
+                    'tag'   : binascii.hexlify(ct[-taglen:]).decode("utf-8")
+                }
+    vecfile.write(testvector)
+
+# RFC 3610 packet vectors 1-3, fixed known answers kept alongside the random vectors
+ccm_rfc3610_packets = [
+    {
+        'key'   : 'c0c1c2c3c4c5c6c7c8c9cacbcccdcecf',
+        'iv'    : '00000003020100a0a1a2a3a4a5',
+        'aad'   : '0001020304050607',
+        'pt'    : '08090a0b0c0d0e0f101112131415161718191a1b1c1d1e',
+        'ct'    : '588c979a61c663d2f066d0c2c0f989806d5f6b61dac384',
+        'tag'   : '17e8d12cfdf926e0',
+    },
+    {
+        'key'   : 'c0c1c2c3c4c5c6c7c8c9cacbcccdcecf',
+        'iv'    : '00000004030201a0a1a2a3a4a5',
+        'aad'   : '0001020304050607',
+        'pt'    : '08090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f',
+        'ct'    : '72c91a36e135f8cf291ca894085c87e3cc15c439c9e43a3b',
+        'tag'   : 'a091d56e10400916',
+    },
+    {
+        'key'   : 'c0c1c2c3c4c5c6c7c8c9cacbcccdcecf',
+        'iv'    : '00000005040302a0a1a2a3a4a5',
+        'aad'   : '0001020304050607',
+        'pt'    : '08090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f20',
+        'ct'    : '51b1e5f44a197d1da46b0f8e2d282ae871e838bb64da859657',
+        'tag'   : '4adaa76fbd9fb0c5',
+    },
+]
+
+def write_ccm_kats():
+    for kat in ccm_rfc3610_packets:
+        vecfile.write(dict(kat, Mode='AES_CCM'))
+
+def generate_cmac(key_size, msglen):
+    assert(key_size in [128,192,256])
+    key = os.urandom(key_size//8)
+    pt = os.urandom(msglen)
+    cmac = CMAC(algorithms.AES(key), default_backend())
+    cmac.update(pt)
+    tag = cmac.finalize()
+    testvector = {  'Mode'  : 'AES_CMAC',
+                    'key'   : binascii.hexlify(key).decode("utf-8"),
+                    'pt'    : binascii.hexlify(pt).decode("utf-8"),
+                    'tag'   : binascii.hexlify(tag).decode("utf-8")
+                }
+    vecfile.write(testvector)
+
+# RFC 4493 section 4 (AES-128) and SP 800-38B appendix D (AES-192, AES-256) examples,
+# fixed known answers kept alongside the random vectors. Each key signs the first
+# 0, 16, 40 and 64 bytes of the same message - (key, [tag for each length])
+cmac_example_msg = ('6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51'
+                    '30c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710')
+cmac_example_lens = [0, 16, 40, 64]
+cmac_examples = [
+    ('2b7e151628aed2a6abf7158809cf4f3c',
+     ['bb1d6929e95937287fa37d129b756746', '070a16b46b4d4144f79bdd9dd04a287c',
+      'dfa66747de9ae63030ca32611497c827', '51f0bebf7e3b9d92fc49741779363cfe']),
+    ('8e73b0f7da0e6452c810f32b809079e562f8ead2522c6b7b',
+     ['d17ddf46adaacde531cac483de7a9367', '9e99a7bf31e710900662f65e617c5184',
+      '8a1de5be2eb31aad089a82e6ee908b0e', 'a1d5df0eed790f794d77589659f39a11']),
+    ('603deb1015ca71be2b73aef0857d77811f352c073b6108d72d9810a30914dff4',
+     ['028962f61b7bf89efc6b551f4667d983', '28a7023f452e8f82bd4bf28d8c37c35c',
+      'aaf3d8f1de5640c232f5b169b9c911e6', 'e1992190549f6ed5696a2c056c315410']),
+]
+
+def write_cmac_kats():
+    for key, tags in cmac_examples:
+        for msglen, tag in zip(cmac_example_lens, tags):
+            testvector = {  'Mode'  : 'AES_CMAC',
+                            'key'   : key,
+                            'pt'    : cmac_example_msg[:2*msglen],
+                            'tag'   : tag
+                        }
+            vecfile.write(testvector)
+
+def generate_gcm_stream(key_size, ptlen, chunk_bytes):
+    assert(key_size in [128,192,256])
+    key = os.urandom(key_size//8)
+    prefix = os.urandom(7)
+    pt = os.urandom(ptlen)
+    num_chunks = max(1, (ptlen + chunk_bytes - 1) // chunk_bytes)
+    header = b'LCGS' + bytes([1,0,0,0]) + struct.pack('>IQ', chunk_bytes, ptlen) + prefix + bytes(5)
+    sealed = header
+    for i in range(0, num_chunks):
+        iv = prefix + struct.pack('>IB', i, 1 if i == num_chunks-1 else 0)
+        aad = header + struct.pack('>Q', i)
+        sealed += AESGCM(key).encrypt(iv, pt[i*chunk_bytes:(i+1)*chunk_bytes], aad)
+    testvector = {  'Mode'  : 'AES_GCM_STREAM',
+                    'key'   : binascii.hexlify(key).decode("utf-8"),
+                    'prefix': binascii.hexlify(prefix).decode("utf-8"),
+                    'chunk' : chunk_bytes,
+                    'pt'    : binascii.hexlify(pt).decode("utf-8"),
+                    'sealed': binascii.hexlify(sealed).decode("utf-8")
+                }
+    vecfile.write(testvector)
+
+def ctr_drbg_update(key, v, provided):
+    temp = b''
+    enc = Cipher(algorithms.AES(key), modes.ECB(), default_backend()).encryptor()
+    for i in range(0,3):
+        v = (v + 1) % (1 << 128)
+        temp += enc.update(v.to_bytes(16, 'big'))
+    temp = bytes(a ^ b for a, b in zip(temp, provided))
+    return temp[:32], int.from_bytes(temp[32:], 'big')
+
+def ctr_drbg_generate(key, v, num_bytes, add):
+    if add:
+        key, v = ctr_drbg_update(key, v, add)
+    out = b''
+    enc = Cipher(algorithms.AES(key), modes.ECB(), default_backend()).encryptor()
+    while len(out) < num_bytes:
+        v = (v + 1) % (1 << 128)
+        out += enc.update(v.to_bytes(16, 'big'))
+    key, v = ctr_drbg_update(key, v, add if add else bytes(48))
+    return key, v, out[:num_bytes]
+
+# CAVP style - instantiate, optional reseed, two generates, second output is checked
+def generate_ctr_drbg(use_pers, use_reseed, use_add):
+    entropy = os.urandom(48)
+    pers = os.urandom(48) if use_pers else b''
+    entropy_reseed = os.urandom(48) if use_reseed else b''
+    add_reseed = os.urandom(48) if use_reseed and use_add else b''
+    add1 = os.urandom(48) if use_add else b''
+    add2 = os.urandom(48) if use_add else b''
+    key, v = ctr_drbg_update(bytes(32), 0, bytes(a ^ b for a, b in zip(entropy, pers if pers else bytes(48))))
+    if use_reseed:
+        key, v = ctr_drbg_update(key, v, bytes(a ^ b for a, b in zip(entropy_reseed, add_reseed if add_reseed else bytes(48))))
+    key, v, out = ctr_drbg_generate(key, v, 64, add1)
+    key, v, out = ctr_drbg_generate(key, v, 64, add2)
+    testvector = {  'Mode'  : 'CTR_DRBG',
+                    'entropy'       : binascii.hexlify(entropy).decode("utf-8"),
+                    'pers'          : binascii.hexlify(pers).decode("utf-8"),
+                    'entropy_reseed': binascii.hexlify(entropy_reseed).decode("utf-8"),
+                    'add_reseed'    : binascii.hexlify(add_reseed).decode("utf-8"),
+                    'add1'          : binascii.hexlify(add1).decode("utf-8"),
+                    'add2'          : binascii.hexlify(add2).decode("utf-8"),
+                    'out'           : binascii.hexlify(out).decode("utf-8")
+                }
+    vecfile.write(testvector)
+
+# Known answers from OpenSSL 3.0 EVP_RAND CTR-DRBG (AES-256-CTR, use_derivation_function=0,
+# explicit empty personalization), an implementation independent of the model above.
+# Same CAVP shapes - with and without reseed, personalization and additional input
+ctr_drbg_kats = [
+    {
+        'entropy'        : '4e97043d455f286b9ab7cf86eae68a17f35fd2041a9690c47d312f91c83d7ca8c39460e13a24daebeb6bf78972583e0f',
+        'pers'           : '',
+        'entropy_reseed' : '',
+        'add_reseed'     : '',
+        'add1'           : '',
+        'add2'           : '',
+        'out'            : '3eb20896d624c7316701bd5d2a3530a87ff0e8db4efaef797305dda32ab322c45789650321656dc8c6636b0609e9a1a0f843133a7a83dfd84ed16c16b1eec275',
+    },
+    {
+        'entropy'        : 'fcf335e517fca4e7796b2b5efebe0909d97d4d205f25a8ebe42b281552992bc8b2ae271ba5f8789054c16598b5ade8ae',
+        'pers'           : '03d29ca832d0db1d04851b967faae10bd89526b08cc65402bf303568ea2009ca4ec678a907d16c35bae49ab2e233477e',
+        'entropy_reseed' : '',
+        'add_reseed'     : '',
+        'add1'           : '50047d9e1f71416224e10957b9d636a35849d76f0b074038339bf7bd849d7f6a3f7c518b6f6c75cc829fedec2fc071bf',
+        'add2'           : '73d6e69f5d3daa15a357c3f9a62307cee5e357c4e29a7dfeb3f9b376b76acd067bc47ae2e7e7480b4d957a2c649ea8b3',
+        'out'            : 'ce5c4a131ce2f3dbc4a5ea7159889db54f0654c34486bbae4963df57a0e0a2307acfc25f5e2737e497c6d1674bed5af347c4c3afda62c4da421f4a698191c9f0',
+    },
+    {
+        'entropy'        : 'ae4e761adbc77cce4aa00f6c52867c45552fefbd36258fb4385b63314cd77ce273aee0e3b15435a0f414cb33aeaaebe5',
+        'pers'           : '',
+        'entropy_reseed' : '179ef3a4a5addaa63eef15763b4f80c8f1781cc7e741e926bb7e98b0f0e31af536b960910902f2f2e0a2b25001200a36',
+        'add_reseed'     : '',
+        'add1'           : '',
+        'add2'           : '',
+        'out'            : 'a160c91418115a93564d02d46bcfcbed4f4cc326f9dddceb4659778ebaba320818459ffa8ee7e9159d792395ab7cd2a96f7d807637a8f04ac79fa4abad459693',
+    },
+    {
+        'entropy'        : '5008fa2f90975ea5394f5b5438389864e1cebe9129084791fcba62209ebc78ba54d189c514690701f3ecff674bee181f',
+        'pers'           : 'ca01d90dcaf0818c6d4e09862c21d1e2db795f5c852f27b118ea550957408890850c80946475a89dee91f00a03dc241e',
+        'entropy_reseed' : 'ad19c7b20bc0538427b40f28763ca7bb99b137ce4a9452aa182f3abc0f39f0c21901806e3338f028bc98453dd0091df6',
+        'add_reseed'     : 'fce7c0313f130a877cc9605d77ff89007418f0e1469edd28b13ff598d5b93307ab46e3ba3d0d9db7366d03bc0f14ed18',
+        'add1'           : '8b993b3029cb5390c7db5ea069dcf7ee44c4a21ec9c7cfbae16386be3a016727874fcdcb13f1d87cfe3fc90d551b5258',
+        'add2'           : 'fec5cfaf9a0ed9a9dc213d433d3074e24d057bda537df6640f0e4751b41c7b7c4f1430a56e639c91c0736fbda2c27de2',
+        'out'            : 'd1bb236d301f90c6aab3b6efbd9dc7e12149c820ee2555ee96d562353f9dd085acce731172dc609b0bb0906c58cc927e0afe6e5ceed85d483359a57ef2a4292b',
+    },
+]
+
+def write_ctr_drbg_kats():
+    for kat in ctr_drbg_kats:
+        vecfile.write(dict(kat, Mode='CTR_DRBG'))
+
+# YAML, or the binary format read by test/test_vectors.cpp when filename ends in .bin
+#   file   : "LCTV" | version u32 | num_records u32 | 0 u32
+#   record : mode_len u8 | mode | num_fields u8 | field ...
+#   field  : name_len u8 | name | type u8 (0 bytes, 1 int64) | len u32 | value
+class vector_writer:
+    def __init__(self, filename):
+        self.binary = filename.endswith('.bin')
+        self.num_records = 0
+        if self.binary:
+            self.f = open(filename, 'wb')
+            self.f.write(b'LCTV' + struct.pack('<III', 1, 0, 0))
+        else:
+            self.f = open(filename, 'w')
+
+    def write(self, testvector):
+        if not self.binary:
+            yaml.dump([testvector],self.f,default_flow_style=False)
+            return
+
+        # bigint vectors name their mode 'operation'
+        mode = testvector.get('Mode', testvector.get('operation', '')).encode("utf-8")
+        fields = [(k, v) for k, v in sorted(testvector.items()) if k not in ['Mode', 'operation']]
+        rec = struct.pack('<B', len(mode)) + mode + struct.pack('<B', len(fields))
+        for name, value in fields:
+            if isinstance(value, int):
+                value = struct.pack('<B', 1) + struct.pack('<Iq', 8, value)
+            else:
+                raw = bytes.fromhex(value)
+                value = struct.pack('<BI', 0, len(raw)) + raw
+            rec += struct.pack('<B', len(name)) + name.encode("utf-8") + value
+        self.f.write(rec)
+        self.num_records = self.num_records + 1
+
+    def close(self):
+        if self.binary:
+            self.f.seek(8)
+            self.f.write(struct.pack('<I', self.num_records))
+        self.f.close()
+
+# gen_aes_test_vectors.py --convert in.yml out.bin
+if len(sys.argv) == 4 and sys.argv[1] == '--convert':
+    vecfile = vector_writer(sys.argv[3])
+    for testvector in yaml.safe_load(open(sys.argv[2])):
+        vecfile.write(testvector)
+    vecfile.close()
+    sys.exit(0)
 
 filename = sys.argv[1]
 num_vectors = int(sys.argv[2])
-yamlfile = open(filename, 'w')
+vecfile = vector_writer(filename)
 
 test_count = 0
 
@@ -83,8 +423,7 @@ for i in range(0,num_vectors):
             generate_xxx(
                 mode,
                 keysize,
-                random.randint(16,10000)//16 * 16,
-                yamlfile
+                random.randint(16,10000)//16 * 16
             )
             test_count = test_count + 1
             print ("Generated " + str(test_count) + " vectors")
@@ -100,5 +439,80 @@ for i in range(0,num_vectors):
         test_count = test_count + 1
         print ("Generated " + str(test_count) + " vectors")
 
-yamlfile.close()
+for i in range(0,num_vectors):
+    for keysize in [128,192,256]:
+
+        generate_gmac(
+            keysize,
+            random.randint(1,10000)
+        )
+        test_count = test_count + 1
+        print ("Generated " + str(test_count) + " vectors")
+
+write_ocb_kats()
+test_count = test_count + len(ocb_rfc7253_samples) + len(ocb_rfc7253_iter)
+
+for i in range(0,num_vectors):
+    for keysize in [128,192,256]:
+
+        generate_ocb(
+            keysize,
+            random.randint(1,10000),
+            random.randint(1,10000)
+        )
+        test_count = test_count + 1
+        print ("Generated " + str(test_count) + " vectors")
+
+write_ccm_kats()
+test_count = test_count + len(ccm_rfc3610_packets)
+
+for i in range(0,num_vectors):
+    for keysize in [128,192,256]:
+
+        generate_ccm(
+            keysize,
+            random.randint(1,10000),
+            random.randint(0,10000),
+            random.choice([4,6,8,10,12,14,16]),
+            random.randint(7,13)
+        )
+        test_count = test_count + 1
+        print ("Generated " + str(test_count) + " vectors")
+
+write_cmac_kats()
+test_count = test_count + len(cmac_examples) * len(cmac_example_lens)
+
+for i in range(0,num_vectors):
+    for keysize in [128,192,256]:
+
+        generate_cmac(
+            keysize,
+            random.randint(0,10000)
+        )
+        test_count = test_count + 1
+        print ("Generated " + str(test_count) + " vectors")
+
+for i in range(0,num_vectors):
+    for keysize in [128,192,256]:
+
+        chunk_bytes = random.randint(1,1024)
+        generate_gcm_stream(
+            keysize,
+            random.choice([0, chunk_bytes, random.randint(1,10000)]),
+            chunk_bytes
+        )
+        test_count = test_count + 1
+        print ("Generated " + str(test_count) + " vectors")
+
+for use_pers in [False, True]:
+    for use_reseed in [False, True]:
+        for use_add in [False, True]:
+            generate_ctr_drbg(use_pers, use_reseed, use_add)
+            test_count = test_count + 1
+            print ("Generated " + str(test_count) + " vectors")
+
+write_ctr_drbg_kats()
+test_count = test_count + len(ctr_drbg_kats)
+
+vecfile.close()
 
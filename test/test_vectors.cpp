@@ -0,0 +1,157 @@
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "common_utils.h"
+#include "test_vectors.h"
+
+static uint32_t get_le32 (const uint8_t *p) {
+	return p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t (p[3]) << 24);
+}
+
+/****************************************************************
+	One vector
+****************************************************************/
+
+test_vector::test_vector (const YAML::Node &node) : node (node) {
+}
+
+test_vector::test_vector (const uint8_t *record) : record (record) {
+}
+
+std::string test_vector::mode () const {
+	if (!record)
+		return node["Mode"].as<std::string>();
+	return std::string((const char *) record+1, record[0]);
+}
+
+// Value of a binary field, exits if the vector doesn't have it
+const uint8_t *test_vector::field (const char *name, uint8_t type, uint32_t &len) const {
+	size_t name_len = strlen(name);
+	const uint8_t *p = record + 1 + record[0];
+	int num_fields = *p++;
+
+	for(int i=0; i<num_fields; i++) {
+		uint8_t n = *p;
+		const uint8_t *value = p + 1 + n + 5;
+		len = get_le32(p + 1 + n + 1);
+
+		if (n == name_len && std::memcmp(p+1, name, n) == 0 && p[1+n] == type)
+			return value;
+
+		p = value + len;
+	}
+
+	std::cout << "Test vector has no field " << name << std::endl;
+	std::exit(1);
+}
+
+tv_bytes test_vector::bytes (const char *name) const {
+	if (!record) {
+		decoded.push_back(str2vec(node[name].as<std::string>()));
+		return tv_bytes(decoded.back().data(), decoded.back().size());
+	}
+
+	uint32_t len;
+	const uint8_t *value = field(name, TV_BYTES, len);
+	return tv_bytes(value, len);
+}
+
+int test_vector::num (const char *name) const {
+	if (!record)
+		return node[name].as<int>();
+
+	uint32_t len;
+	const uint8_t *value = field(name, TV_INT, len);
+
+	int64_t v = 0;
+	for(int i=7; i>=0; i--)
+		v = (v << 8) | value[i];
+	return int (v);
+}
+
+/****************************************************************
+	Vector file
+****************************************************************/
+
+test_vector_file::test_vector_file (const char *path) {
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		std::cout << "Can't open " << path << std::endl;
+		std::exit(1);
+	}
+
+	struct stat st;
+	fstat(fd, &st);
+
+	char magic[4] = {0};
+	if (st.st_size < 16 || pread(fd, magic, 4, 0) != 4 || std::memcmp(magic, "LCTV", 4) != 0) {
+		close(fd);
+		root = YAML::LoadFile(path);
+		return;
+	}
+
+	map_bytes = st.st_size;
+	void *m = mmap(nullptr, map_bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (m == MAP_FAILED) {
+		std::cout << "Can't map " << path << std::endl;
+		std::exit(1);
+	}
+	map = (const uint8_t *) m;
+
+	if (get_le32(map+4) != 1) {
+		std::cout << "Unsupported test vector version " << get_le32(map+4) << std::endl;
+		std::exit(1);
+	}
+
+	// Index record offsets, checking every field stays inside the file
+	uint32_t num_records = get_le32(map+8);
+	const uint8_t *p = map + 16, *end = map + map_bytes;
+	records.reserve(num_records);
+
+	for(uint32_t r=0; r<num_records; r++) {
+		const uint8_t *rec = p;
+		bool ok = p+1 <= end && (p += 1 + p[0]) + 1 <= end;
+		int num_fields = ok ? *p++ : 0;
+
+		for(int i=0; ok && i<num_fields; i++) {
+			ok = p+1 <= end && (p += 1 + p[0]) + 5 <= end;
+			if (ok) {
+				uint32_t len = get_le32(p+1);
+				p += 5;
+				ok = len <= size_t (end - p);
+				p += ok ? len : 0;
+			}
+		}
+
+		if (!ok) {
+			std::cout << "Truncated test vector file " << path << std::endl;
+			std::exit(1);
+		}
+		records.push_back(rec);
+	}
+}
+
+test_vector_file::~test_vector_file () {
+	if (map)
+		munmap((void *) map, map_bytes);
+}
+
+bool test_vector_file::is_binary () const {
+	return map != nullptr;
+}
+
+size_t test_vector_file::size () const {
+	return map ? records.size() : root.size();
+}
+
+test_vector test_vector_file::operator[] (size_t i) const {
+	if (map)
+		return test_vector(records[i]);
+	return test_vector(root[i]);
+}
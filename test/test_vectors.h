@@ -0,0 +1,94 @@
+#ifndef _TEST_VECTORS_H
+#define _TEST_VECTORS_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "yaml-cpp/yaml.h"
+
+/****************************************************************
+	Test vector files - YAML or the binary format written by
+	gen_aes_test_vectors.py for *.bin outputs, picked by magic.
+
+	file   : "LCTV" | version u32 | num_records u32 | 0 u32
+	record : mode_len u8 | mode | num_fields u8 | field ...
+	field  : name_len u8 | name | type u8 | len u32 | value
+		type 0 - raw bytes, type 1 - int64
+	All integers little endian.
+
+	Binary files are mmap'd and records are read in place, no
+	parsing beyond one pass to index the record offsets. bytes()
+	returns a view straight into the mapping, YAML values are
+	decoded once and owned by the test_vector.
+****************************************************************/
+
+#define TV_BYTES 	0
+#define TV_INT 		1
+
+// Read only view of a bytes field, valid as long as its test_vector and file
+class tv_bytes {
+
+	public:
+		tv_bytes () = default;
+		tv_bytes (const uint8_t *ptr, size_t len) : ptr (ptr), len (len) {}
+
+		const uint8_t *data () const { return ptr; }
+		size_t size () const { return len; }
+		bool empty () const { return len == 0; }
+		const uint8_t *begin () const { return ptr; }
+		const uint8_t *end () const { return ptr + len; }
+		uint8_t operator[] (size_t i) const { return ptr[i]; }
+
+	private:
+		const uint8_t 	*ptr = nullptr;
+		size_t 			len = 0;
+};
+
+inline bool operator== (const std::vector<uint8_t> &lhs, tv_bytes rhs) {
+	return lhs.size() == rhs.size() && std::equal(lhs.begin(), lhs.end(), rhs.begin());
+}
+
+inline bool operator== (tv_bytes lhs, const std::vector<uint8_t> &rhs) {
+	return rhs == lhs;
+}
+
+class test_vector {
+
+	public:
+		test_vector (const YAML::Node &node);
+		test_vector (const uint8_t *record);
+
+		std::string mode () const;
+		tv_bytes bytes (const char *name) const;
+		int num (const char *name) const;
+
+	private:
+		YAML::Node 		node;
+		const uint8_t 	*record = nullptr;
+		mutable std::deque<std::vector<uint8_t>> decoded;	// YAML values handed out by bytes()
+
+		const uint8_t *field (const char *name, uint8_t type, uint32_t &len) const;
+};
+
+class test_vector_file {
+
+	public:
+		test_vector_file (const char *path);
+		~test_vector_file ();
+
+		size_t size () const;
+		bool is_binary () const;
+		test_vector operator[] (size_t i) const;
+
+	private:
+		YAML::Node 		root;
+		const uint8_t 	*map = nullptr;
+		size_t 			map_bytes = 0;
+		std::vector<const uint8_t *> records;
+};
+
+#endif